@@ -3,6 +3,13 @@
 #include <cstdarg>
 #include <functional>
 #include <cmath>
+#include <memory>
+#include <cassert>
+#include <cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define X86_SIMD
+#endif
 
 using namespace std;
 
@@ -186,4 +193,186 @@ function<long double(long double*)> MSE(int length_of_data, const long double* x
     };
 }
 
+// ----------- BATCHED KERNELS -----------
+// The widest instruction set that is at most the one asked for and that the cpu supports.
+static simd_level_t supported(simd_level_t simd){
+#ifdef X86_SIMD
+    static bool avx512 = (__builtin_cpu_init(), __builtin_cpu_supports("avx512f"));
+    static bool avx2 = __builtin_cpu_supports("avx2");
+    if((simd == SIMD_AUTO || simd == SIMD_AVX512) && avx512) return SIMD_AVX512;
+    if(simd != SIMD_SCALAR && avx2) return SIMD_AVX2;
+#endif
+    return SIMD_SCALAR;
+}
+
+// Adds w[i] * (y[i] - p[i])^2 to sum_of_error_squared and w[i] to sum_of_weights for every
+// point whose error is not NaN.
+static void squared_errors_scalar(int length, const double y[], const double p[], const double w[], 
+    long double& sum_of_error_squared, long double& sum_of_weights){
+    for(int i = 0; i < length; ++i){
+        long double error_squared = ((long double) y[i] - p[i]) * ((long double) y[i] - p[i]);
+        if(isnan(error_squared)) continue;
+        sum_of_error_squared += w[i] * error_squared;
+        sum_of_weights += w[i];
+    }
+}
+
+static void logistic_scalar(int length, const double x[], double alpha, double beta, double center, double scale, double out[]){
+    for(int i = 0; i < length; ++i){
+        out[i] = alpha + beta / (1 + exp(-(x[i] - center) * scale));
+    }
+}
+
+#ifdef X86_SIMD
+// e^r for |r| <= ln(2) / 2, through its Taylor series (the 14th term is below 2^-53).
+#define EXP_TERMS 14
+static const double EXP_COEFFICIENTS[EXP_TERMS] = {1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 
+    1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800};
+static const double LN2_HI = 6.93145751953125e-1;
+static const double LN2_LO = 1.42860682030941723212e-6;
+
+__attribute__((target("avx2")))
+static void squared_errors_avx2(int length, const double y[], const double p[], const double w[], 
+    long double& sum_of_error_squared, long double& sum_of_weights){
+    __m256d errors = _mm256_setzero_pd();
+    __m256d weights = _mm256_setzero_pd();
+    int i = 0;
+    for(; i + 4 <= length; i += 4){
+        __m256d error = _mm256_sub_pd(_mm256_loadu_pd(y + i), _mm256_loadu_pd(p + i));
+        __m256d error_squared = _mm256_mul_pd(error, error);
+        __m256d weight = _mm256_loadu_pd(w + i);
+        __m256d not_nan = _mm256_cmp_pd(error_squared, error_squared, _CMP_ORD_Q);
+        errors = _mm256_add_pd(errors, _mm256_and_pd(not_nan, _mm256_mul_pd(weight, error_squared)));
+        weights = _mm256_add_pd(weights, _mm256_and_pd(not_nan, weight));
+    }
+
+    double lanes[2][4];
+    _mm256_storeu_pd(lanes[0], errors);
+    _mm256_storeu_pd(lanes[1], weights);
+    for(int lane = 0; lane < 4; ++lane){
+        sum_of_error_squared += lanes[0][lane];
+        sum_of_weights += lanes[1][lane];
+    }
+    squared_errors_scalar(length - i, y + i, p + i, w + i, sum_of_error_squared, sum_of_weights);
+}
+
+__attribute__((target("avx2")))
+static __m256d exp_avx2(__m256d x){
+    // e^x = 2^k e^r, with k = round(x / ln(2)) and r = x - k ln(2).
+    x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(708)), _mm256_set1_pd(-708));
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(M_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(LN2_HI))), _mm256_mul_pd(k, _mm256_set1_pd(LN2_LO)));
+
+    __m256d e_r = _mm256_set1_pd(EXP_COEFFICIENTS[EXP_TERMS - 1]);
+    for(int term = EXP_TERMS - 2; term >= 0; --term){
+        e_r = _mm256_add_pd(_mm256_set1_pd(EXP_COEFFICIENTS[term]), _mm256_mul_pd(e_r, r));
+    }
+
+    // 2^k, written straight into the exponent bits.
+    __m256i exponent = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k)), _mm256_set1_epi64x(1023));
+    return _mm256_mul_pd(e_r, _mm256_castsi256_pd(_mm256_slli_epi64(exponent, 52)));
+}
+
+__attribute__((target("avx2")))
+static void logistic_avx2(int length, const double x[], double alpha, double beta, double center, double scale, double out[]){
+    int i = 0;
+    for(; i + 4 <= length; i += 4){
+        __m256d z = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(center), _mm256_loadu_pd(x + i)), _mm256_set1_pd(scale));
+        __m256d sigmoid = _mm256_div_pd(_mm256_set1_pd(1), _mm256_add_pd(_mm256_set1_pd(1), exp_avx2(z)));
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_set1_pd(alpha), _mm256_mul_pd(_mm256_set1_pd(beta), sigmoid)));
+    }
+    logistic_scalar(length - i, x + i, alpha, beta, center, scale, out + i);
+}
+
+__attribute__((target("avx512f")))
+static void squared_errors_avx512(int length, const double y[], const double p[], const double w[], 
+    long double& sum_of_error_squared, long double& sum_of_weights){
+    __m512d errors = _mm512_setzero_pd();
+    __m512d weights = _mm512_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= length; i += 8){
+        __m512d error = _mm512_sub_pd(_mm512_loadu_pd(y + i), _mm512_loadu_pd(p + i));
+        __m512d error_squared = _mm512_mul_pd(error, error);
+        __m512d weight = _mm512_loadu_pd(w + i);
+        __mmask8 not_nan = _mm512_cmp_pd_mask(error_squared, error_squared, _CMP_ORD_Q);
+        errors = _mm512_mask_add_pd(errors, not_nan, errors, _mm512_mul_pd(weight, error_squared));
+        weights = _mm512_mask_add_pd(weights, not_nan, weights, weight);
+    }
+
+    sum_of_error_squared += _mm512_reduce_add_pd(errors);
+    sum_of_weights += _mm512_reduce_add_pd(weights);
+    squared_errors_scalar(length - i, y + i, p + i, w + i, sum_of_error_squared, sum_of_weights);
+}
+
+__attribute__((target("avx512f")))
+static __m512d exp_avx512(__m512d x){
+    // e^x = 2^k e^r, with k = round(x / ln(2)) and r = x - k ln(2).
+    x = _mm512_max_pd(_mm512_min_pd(x, _mm512_set1_pd(708)), _mm512_set1_pd(-708));
+    __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(M_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_sub_pd(_mm512_sub_pd(x, _mm512_mul_pd(k, _mm512_set1_pd(LN2_HI))), _mm512_mul_pd(k, _mm512_set1_pd(LN2_LO)));
+
+    __m512d e_r = _mm512_set1_pd(EXP_COEFFICIENTS[EXP_TERMS - 1]);
+    for(int term = EXP_TERMS - 2; term >= 0; --term){
+        e_r = _mm512_add_pd(_mm512_set1_pd(EXP_COEFFICIENTS[term]), _mm512_mul_pd(e_r, r));
+    }
+
+    return _mm512_scalef_pd(e_r, k);
+}
+
+__attribute__((target("avx512f")))
+static void logistic_avx512(int length, const double x[], double alpha, double beta, double center, double scale, double out[]){
+    int i = 0;
+    for(; i + 8 <= length; i += 8){
+        __m512d z = _mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(center), _mm512_loadu_pd(x + i)), _mm512_set1_pd(scale));
+        __m512d sigmoid = _mm512_div_pd(_mm512_set1_pd(1), _mm512_add_pd(_mm512_set1_pd(1), exp_avx512(z)));
+        _mm512_storeu_pd(out + i, _mm512_add_pd(_mm512_set1_pd(alpha), _mm512_mul_pd(_mm512_set1_pd(beta), sigmoid)));
+    }
+    logistic_scalar(length - i, x + i, alpha, beta, center, scale, out + i);
+}
+#endif
+
+function<long double(long double*)> MSE(int length_of_data, const double x[], const double y[], const double w[], 
+    batch_function_t func, simd_level_t simd){
+    simd = supported(simd);
+    // the predictions of func, reused by every evaluation.
+    shared_ptr<vector<double>> predictions = make_shared<vector<double>>(length_of_data);
+
+    return [length_of_data, x, y, w, func, simd, predictions](long double args[]) -> long double {
+        long double sum_of_error_squared = 0;
+        long double sum_of_weights = 0;
+        double* p = predictions->data();
+        func(length_of_data, x, args, p);
+
+        switch(simd){
+#ifdef X86_SIMD
+        case SIMD_AVX512:
+            squared_errors_avx512(length_of_data, y, p, w, sum_of_error_squared, sum_of_weights);
+            break;
+        case SIMD_AVX2:
+            squared_errors_avx2(length_of_data, y, p, w, sum_of_error_squared, sum_of_weights);
+            break;
+#endif
+        default:
+            squared_errors_scalar(length_of_data, y, p, w, sum_of_error_squared, sum_of_weights);
+        }
+
+        return sum_of_error_squared / sum_of_weights;
+    };
+}
+
+void logistic(int length, const double x[], double alpha, double beta, double center, double scale, double out[], simd_level_t simd){
+    switch(supported(simd)){
+#ifdef X86_SIMD
+    case SIMD_AVX512:
+        logistic_avx512(length, x, alpha, beta, center, scale, out);
+        break;
+    case SIMD_AVX2:
+        logistic_avx2(length, x, alpha, beta, center, scale, out);
+        break;
+#endif
+    default:
+        logistic_scalar(length, x, alpha, beta, center, scale, out);
+    }
+}
+
 #undef gd
\ No newline at end of file
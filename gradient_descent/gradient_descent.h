@@ -4,12 +4,35 @@
 #include <vector>
 #include <cstdarg>
 #include <functional>
+#include <cmath>
 
 using namespace std;
 
 function<long double(long double*)> MSE(int length_of_data, const long double* x[], const long double y[], 
     function<long double(const long double*, long double*)> func);
 
+// The instruction set that the batched kernels below run with. SIMD_AUTO picks the widest
+// one the cpu supports, and asking for one that the cpu does not support falls back to a
+// narrower one (AVX2 and AVX-512 are only available on x86).
+typedef enum simd_level{
+    SIMD_AUTO,
+    SIMD_SCALAR,
+    SIMD_AVX2,
+    SIMD_AVX512
+} simd_level_t;
+
+// A function evaluated for a whole batch of points: out[i] = f(x[i], args) for 0 <= i < length.
+typedef function<void(int, const double*, const long double*, double*)> batch_function_t;
+
+// The weighted mean of the squared errors, sum(w * e^2) / sum(w), over contiguous arrays. func
+// evaluates every point at once, and the errors are summed with the given instruction set.
+function<long double(long double*)> MSE(int length_of_data, const double x[], const double y[], const double w[], 
+    batch_function_t func, simd_level_t simd=SIMD_AUTO);
+
+// out[i] = alpha + beta / (1 + e^(-(x[i] - center) * scale)) for 0 <= i < length.
+void logistic(int length, const double x[], double alpha, double beta, double center, double scale, double out[], 
+    simd_level_t simd=SIMD_AUTO);
+
 class gradient_descent{
 private:
     function<long double(long double[])> func;
@@ -38,4 +61,75 @@ public:
     vector<long double> run();
 };
 
+// Gradient descent on a loss that computes its own (analytic) gradient. Loss is a functor
+//     long double operator()(const long double args[], long double gradient[])
+// that returns the loss at args and fills in its NUM_ARGS partial derivatives. It is called
+// directly (and inlined) rather than through a std::function, and one call per iteration
+// replaces the NUM_ARGS + 1 calls of the finite differences in gradient_descent. The step
+// size follows Barzilai-Borwein, and is halved while a step would increase the loss.
+template<int NUM_ARGS, typename Loss>
+class analytic_gradient_descent{
+private:
+    Loss loss;
+    int iterations;
+    bool min;
+    long double guess[NUM_ARGS];
+
+public:
+    analytic_gradient_descent(Loss loss, int iterations) : loss(loss), iterations(iterations), min(true){
+        for(int i = 0; i < NUM_ARGS; ++i) guess[i] = 0;
+    }
+
+    void set_iterations(int iterations){
+        this->iterations = iterations;
+    }
+
+    void set_guess(const long double* guess){
+        for(int i = 0; i < NUM_ARGS; ++i) this->guess[i] = guess[i];
+    }
+
+    void set_min_or_max(bool min){
+        this->min = min;
+    }
+
+    vector<long double> get_guess(){
+        return vector<long double>(guess, guess + NUM_ARGS);
+    }
+
+    vector<long double> run(){
+        long double sign = min ? 1 : -1;
+        long double gradient[NUM_ARGS];
+        long double next_guess[NUM_ARGS];
+        long double next_gradient[NUM_ARGS];
+        long double learning_rate = 0.1;
+        long double value = sign * loss(guess, gradient);
+
+        for(int iteration = 0; iteration < iterations; ++iteration){
+            long double next_value = NAN;
+            for(int halvings = 0; halvings < 30; ++halvings, learning_rate /= 2){
+                for(int i = 0; i < NUM_ARGS; ++i) next_guess[i] = guess[i] - sign * learning_rate * gradient[i];
+                next_value = sign * loss(next_guess, next_gradient);
+                if(next_value <= value) break;
+            }
+            if(!(next_value <= value)) break; // no step along the gradient helps: we are at a minimum.
+
+            // Barzilai-Borwein: the step size that fits the change in the gradient over the last step.
+            long double dot = 0;
+            long double norm = 0;
+            for(int i = 0; i < NUM_ARGS; ++i){
+                long double step = next_guess[i] - guess[i];
+                long double change = sign * (next_gradient[i] - gradient[i]);
+                dot += step * change;
+                norm += change * change;
+                guess[i] = next_guess[i];
+                gradient[i] = next_gradient[i];
+            }
+            learning_rate = (norm > 0 && dot > 0) ? dot / norm : 2 * learning_rate;
+            value = next_value;
+        }
+
+        return get_guess();
+    }
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "in_process.h"
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+using namespace std;
+
+#define WATCHDOG_SIGNAL SIGUSR2
+#define GRACE_PERIOD 1000000000 // ns we give the measurement thread to acknowledge an interruption.
+#define ALT_STACK_SIZE 65536
+#define NUM_HANDLED_SIGNALS 5
+
+static const int handled_signals[NUM_HANDLED_SIGNALS] = {WATCHDOG_SIGNAL, SIGSEGV, SIGBUS, SIGFPE, SIGILL};
+
+// The measurement thread jumps back to interrupt_point when a handled signal arrives
+// while it is running the task.
+static thread_local sigjmp_buf interrupt_point;
+static thread_local volatile sig_atomic_t armed = 0;
+
+// ----------- PRIVATE -----------
+void in_process_runner::install_handlers(){
+    struct sigaction action = {};
+    action.sa_handler = handler;
+    action.sa_flags = SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    for(int i = 0; i < NUM_HANDLED_SIGNALS; ++i){
+        sigaction(handled_signals[i], &action, &previous_actions[i]);
+    }
+}
+
+void in_process_runner::restore_handlers(){
+    for(int i = 0; i < NUM_HANDLED_SIGNALS; ++i){
+        sigaction(handled_signals[i], &previous_actions[i], nullptr);
+    }
+}
+
+void in_process_runner::handler(int sig){
+    if(armed){
+        armed = 0;
+        siglongjmp(interrupt_point, sig);
+    }
+
+    // The signal is not meant for a running task: either the watchdog was late (ignore it)
+    // or some other thread faulted, in which case the default action has to happen.
+    if(sig != WATCHDOG_SIGNAL){
+        signal(sig, SIG_DFL);
+    }
+}
+
+void in_process_runner::measurement_loop(shared_ptr<shared_state_t> state){
+    // an alternate signal stack lets us recover from a stack overflow inside of the task.
+    stack_t ss;
+    ss.ss_sp = malloc(ALT_STACK_SIZE);
+    ss.ss_size = ALT_STACK_SIZE;
+    ss.ss_flags = 0;
+    sigaltstack(&ss, nullptr);
+
+    while(true){
+        sample_request_t request;
+        {
+            unique_lock<mutex> guard(state->lock);
+            state->cv.wait(guard, [&state]{return state->has_request || state->stop;});
+            if(state->stop) break;
+            state->has_request = false;
+            request = state->request;
+        }
+
+        dd_t sample;
+        int outcome;
+        int sig = sigsetjmp(interrupt_point, 1);
+        if(sig == 0){
+            armed = 1;
+            sample = state->task(request);
+            armed = 0;
+            outcome = IN_PROCESS_IN_BUDGET;
+        }else{
+            outcome = (sig == WATCHDOG_SIGNAL) ? IN_PROCESS_OVER_BUDGET : IN_PROCESS_CRASHED;
+        }
+
+        {
+            lock_guard<mutex> guard(state->lock);
+            state->outcome = outcome;
+            if(outcome == IN_PROCESS_IN_BUDGET) state->result = sample;
+            state->has_result = true;
+        }
+        state->cv.notify_all();
+    }
+
+    ss.ss_flags = SS_DISABLE;
+    sigaltstack(&ss, nullptr);
+    free(ss.ss_sp);
+}
+
+// ----------- PUBLIC -----------
+in_process_runner::in_process_runner(function<dd_t(sample_request_t)> task){
+    state = make_shared<shared_state_t>();
+    state->task = task;
+    state->request = {0, 1, 0, false, false, false};
+    state->has_request = false;
+    state->has_result = false;
+    state->stop = false;
+    state->outcome = IN_PROCESS_IN_BUDGET;
+    this->broken = false;
+    this->stuck = false;
+
+    install_handlers();
+    measurer = thread(measurement_loop, state);
+    measurer_handle = measurer.native_handle();
+}
+
+in_process_runner::~in_process_runner(){
+    {
+        lock_guard<mutex> guard(state->lock);
+        state->stop = true;
+    }
+    state->cv.notify_all();
+
+    // a thread that never came back from an interruption cannot be joined, we leave it behind
+    // (with its reference to the shared state).
+    if(stuck) measurer.detach();
+    else measurer.join();
+
+    restore_handlers();
+}
+
+// Runs the task for the request on the measurement thread and waits at most budget nanoseconds
+// for it. Returns IN_PROCESS_IN_BUDGET (and fills in result), IN_PROCESS_OVER_BUDGET or
+// IN_PROCESS_CRASHED. After anything but IN_PROCESS_IN_BUDGET the runner is unusable.
+int in_process_runner::run(sample_request_t request, long long budget, dd_t& result){
+    unique_lock<mutex> guard(state->lock);
+    state->request = request;
+    state->has_request = true;
+    state->has_result = false;
+    state->cv.notify_all();
+
+    shared_state_t* shared = state.get();
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::nanoseconds(budget);
+    if(!state->cv.wait_until(guard, deadline, [shared]{return shared->has_result;})){
+        // watchdog: interrupt the task.
+        pthread_kill(measurer_handle, WATCHDOG_SIGNAL);
+        if(!state->cv.wait_for(guard, chrono::nanoseconds(GRACE_PERIOD), [shared]{return shared->has_result;})){
+            broken = true;
+            stuck = true;
+            return IN_PROCESS_OVER_BUDGET;
+        }
+    }
+
+    state->has_result = false;
+    if(state->outcome != IN_PROCESS_IN_BUDGET){
+        broken = true;
+        return state->outcome;
+    }
+
+    result = state->result;
+    return IN_PROCESS_IN_BUDGET;
+}
+
+bool in_process_runner::usable(){
+    return !broken;
+}
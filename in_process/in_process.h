@@ -0,0 +1,61 @@
+#ifndef IN_PROCESS
+#define IN_PROCESS
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <signal.h>
+#include "../time_complexity.h"
+
+using namespace std;
+
+#define IN_PROCESS_IN_BUDGET 0
+#define IN_PROCESS_OVER_BUDGET 1
+#define IN_PROCESS_CRASHED 2
+
+// Runs the task on a dedicated measurement thread in this process. A watchdog (the
+// calling thread) interrupts a sample that runs over its budget by signalling the
+// measurement thread, whose handler siglongjmps out of the task. Faults inside the
+// task (SIGSEGV, SIGBUS, SIGFPE, SIGILL) are caught the same way.
+// An interrupted task may leave locks held or memory leaked, so after the first
+// interruption the runner is no longer usable and the caller has to measure in a
+// separate process instead.
+class in_process_runner{
+private:
+    // What the runner and its measurement thread share. The thread holds its own reference,
+    // so that a thread that never came back from an interruption (and is left behind when
+    // the runner is destroyed) never touches freed memory.
+    typedef struct shared_state{
+        function<dd_t(sample_request_t)> task;
+        mutex lock;
+        condition_variable cv;
+        sample_request_t request;
+        bool has_request;
+        bool has_result;
+        bool stop;
+        int outcome;
+        dd_t result;
+    } shared_state_t;
+    shared_ptr<shared_state_t> state;
+    thread measurer;
+    pthread_t measurer_handle;
+    bool broken;
+    bool stuck;
+    struct sigaction previous_actions[5];
+    void install_handlers();
+    void restore_handlers();
+    static void handler(int sig);
+    static void measurement_loop(shared_ptr<shared_state_t> state);
+
+public:
+    in_process_runner(function<dd_t(sample_request_t)> task);
+    in_process_runner(const in_process_runner&) = delete;
+    in_process_runner& operator=(const in_process_runner&) = delete;
+    ~in_process_runner();
+    int run(sample_request_t request, long long budget, dd_t& result);
+    bool usable();
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "least_squares.h"
+#include <math.h>
+#include <vector>
+
+using namespace std;
+
+static bool usable(long double x, long double y, long double w){
+    return w > 0 && !isnan(x) && !isinf(x) && !isnan(y) && !isinf(y);
+}
+
+// Fills in the residual and r_squared of the fit, with r_squared taken around center.
+static void goodness_of_fit(linear_fit_t& fit, int length_of_data, const long double x[], const long double y[], 
+    const long double w[], long double center){
+    long double sum_of_weights = 0;
+    long double sum_of_error_squared = 0;
+    long double sum_of_squares = 0;
+
+    for(int i = 0; i < length_of_data; ++i){
+        if(!usable(x[i], y[i], w[i])) continue;
+        long double error = y[i] - fit.intercept - fit.slope * x[i];
+        sum_of_weights += w[i];
+        sum_of_error_squared += w[i] * error * error;
+        sum_of_squares += w[i] * (y[i] - center) * (y[i] - center);
+    }
+
+    fit.residual = sum_of_weights > 0 ? sum_of_error_squared / sum_of_weights : NAN;
+    fit.r_squared = sum_of_squares > 0 ? 1 - sum_of_error_squared / sum_of_squares : NAN;
+}
+
+linear_fit_t fit_line(int length_of_data, const long double x[], const long double y[], const long double w[]){
+    // the weighted means first, so that the sums below do not lose precision to large x.
+    long double sum_of_weights = 0;
+    long double mean_x = 0;
+    long double mean_y = 0;
+    for(int i = 0; i < length_of_data; ++i){
+        if(!usable(x[i], y[i], w[i])) continue;
+        sum_of_weights += w[i];
+        mean_x += w[i] * x[i];
+        mean_y += w[i] * y[i];
+    }
+
+    linear_fit_t fit = {NAN, NAN, NAN, NAN};
+    if(sum_of_weights <= 0) return fit;
+    mean_x /= sum_of_weights;
+    mean_y /= sum_of_weights;
+
+    long double sxx = 0;
+    long double sxy = 0;
+    for(int i = 0; i < length_of_data; ++i){
+        if(!usable(x[i], y[i], w[i])) continue;
+        sxx += w[i] * (x[i] - mean_x) * (x[i] - mean_x);
+        sxy += w[i] * (x[i] - mean_x) * (y[i] - mean_y);
+    }
+
+    // every x is the same: the best line is flat.
+    fit.slope = sxx > 0 ? sxy / sxx : 0;
+    fit.intercept = mean_y - fit.slope * mean_x;
+    goodness_of_fit(fit, length_of_data, x, y, w, mean_y);
+
+    return fit;
+}
+
+linear_fit_t fit_proportional(int length_of_data, const long double x[], const long double y[], const long double w[]){
+    long double sxx = 0;
+    long double sxy = 0;
+    for(int i = 0; i < length_of_data; ++i){
+        if(!usable(x[i], y[i], w[i])) continue;
+        sxx += w[i] * x[i] * x[i];
+        sxy += w[i] * x[i] * y[i];
+    }
+
+    linear_fit_t fit = {0, sxx > 0 ? sxy / sxx : NAN, NAN, NAN};
+    if(sxx > 0) goodness_of_fit(fit, length_of_data, x, y, w, 0);
+
+    return fit;
+}
+
+void add_point(online_fit_t& fit, long double x, long double y, long double w){
+    if(!usable(x, y, w)) return;
+
+    long double sum_of_weights = fit.sum_of_weights + w;
+    long double dx = x - fit.mean_x;
+    long double dy = y - fit.mean_y;
+    fit.mean_x += dx * w / sum_of_weights;
+    fit.mean_y += dy * w / sum_of_weights;
+    fit.cxx += w * dx * (x - fit.mean_x);
+    fit.cxy += w * dx * (y - fit.mean_y);
+    fit.cyy += w * dy * (y - fit.mean_y);
+    fit.sum_of_weights = sum_of_weights;
+
+    fit.sxx += w * x * x;
+    fit.sxy += w * x * y;
+    fit.syy += w * y * y;
+}
+
+linear_fit_t online_line(const online_fit_t& fit){
+    linear_fit_t line = {NAN, NAN, NAN, NAN};
+    if(fit.sum_of_weights <= 0) return line;
+
+    // every x is the same: the best line is flat.
+    line.slope = fit.cxx > 0 ? fit.cxy / fit.cxx : 0;
+    line.intercept = fit.mean_y - line.slope * fit.mean_x;
+    long double sum_of_error_squared = fit.cyy - line.slope * fit.cxy;
+    if(sum_of_error_squared < 0) sum_of_error_squared = 0;
+    line.residual = sum_of_error_squared / fit.sum_of_weights;
+    line.r_squared = fit.cyy > 0 ? 1 - sum_of_error_squared / fit.cyy : NAN;
+
+    return line;
+}
+
+linear_fit_t online_proportional(const online_fit_t& fit){
+    linear_fit_t line = {0, fit.sxx > 0 ? fit.sxy / fit.sxx : NAN, NAN, NAN};
+    if(!(fit.sxx > 0)) return line;
+
+    long double sum_of_error_squared = fit.syy - line.slope * fit.sxy;
+    if(sum_of_error_squared < 0) sum_of_error_squared = 0;
+    line.residual = sum_of_error_squared / fit.sum_of_weights;
+    line.r_squared = fit.syy > 0 ? 1 - sum_of_error_squared / fit.syy : NAN;
+
+    return line;
+}
+
+long double fit_linear_model(int length_of_data, int num_regressors, const long double* regressors[], const long double y[], 
+    const long double w[], long double coefficients[], bool intercept){
+    int p = num_regressors;
+    vector<bool> used(length_of_data, false);
+    vector<long double> means(p, 0);
+    long double mean_y = 0;
+    long double sum_of_weights = 0;
+    for(int i = 0; i < length_of_data; ++i){
+        used[i] = usable(0, y[i], w[i]);
+        for(int k = 0; k < p && used[i]; ++k) used[i] = !isnan(regressors[k][i]) && !isinf(regressors[k][i]);
+        if(!used[i]) continue;
+        sum_of_weights += w[i];
+        mean_y += w[i] * y[i];
+        for(int k = 0; k < p; ++k) means[k] += w[i] * regressors[k][i];
+    }
+    if(sum_of_weights <= 0) return NAN;
+    mean_y = intercept ? mean_y / sum_of_weights : 0;
+    for(int k = 0; k < p; ++k) means[k] = intercept ? means[k] / sum_of_weights : 0;
+
+    // the normal equations A b = c of the centered regressors, with c in the last column.
+    vector<long double> A(p * (p + 1), 0);
+    for(int i = 0; i < length_of_data; ++i){
+        if(!used[i]) continue;
+        for(int j = 0; j < p; ++j){
+            long double rj = regressors[j][i] - means[j];
+            for(int k = 0; k < p; ++k) A[j * (p + 1) + k] += w[i] * rj * (regressors[k][i] - means[k]);
+            A[j * (p + 1) + p] += w[i] * rj * (y[i] - mean_y);
+        }
+    }
+
+    // Gaussian elimination with partial pivoting.
+    for(int col = 0; col < p; ++col){
+        int pivot = col;
+        for(int row = col + 1; row < p; ++row){
+            if(fabsl(A[row * (p + 1) + col]) > fabsl(A[pivot * (p + 1) + col])) pivot = row;
+        }
+        if(!(fabsl(A[pivot * (p + 1) + col]) > 0)) return NAN;
+        for(int k = 0; k <= p; ++k) swap(A[col * (p + 1) + k], A[pivot * (p + 1) + k]);
+        for(int row = col + 1; row < p; ++row){
+            long double factor = A[row * (p + 1) + col] / A[col * (p + 1) + col];
+            for(int k = col; k <= p; ++k) A[row * (p + 1) + k] -= factor * A[col * (p + 1) + k];
+        }
+    }
+
+    coefficients[0] = mean_y;
+    for(int row = p - 1; row >= 0; --row){
+        long double sum = A[row * (p + 1) + p];
+        for(int k = row + 1; k < p; ++k) sum -= A[row * (p + 1) + k] * coefficients[k + 1];
+        coefficients[row + 1] = sum / A[row * (p + 1) + row];
+        coefficients[0] -= coefficients[row + 1] * means[row];
+    }
+
+    long double sum_of_error_squared = 0;
+    for(int i = 0; i < length_of_data; ++i){
+        if(!used[i]) continue;
+        long double error = y[i] - coefficients[0];
+        for(int k = 0; k < p; ++k) error -= coefficients[k + 1] * regressors[k][i];
+        sum_of_error_squared += w[i] * error * error;
+    }
+
+    return sum_of_error_squared / sum_of_weights;
+}
@@ -0,0 +1,50 @@
+#ifndef LEAST_SQUARES
+#define LEAST_SQUARES
+
+// The result of a weighted least squares fit of y = intercept + slope * x.
+typedef struct linear_fit{
+    long double intercept;
+    long double slope;
+    long double residual;  // the weighted mean of the squared residuals
+    long double r_squared; // the fraction of the weighted sum of squares of y that the fit explains
+} linear_fit_t;
+
+// Fits y = intercept + slope * x, minimizing sum(w * (y - intercept - slope * x)^2), in
+// closed form. Points with a weight of 0 (or a NaN/infinite x or y) are ignored.
+linear_fit_t fit_line(int length_of_data, const long double x[], const long double y[], const long double w[]);
+
+// Same as fit_line, with the intercept fixed at 0 (r_squared is then taken around 0).
+linear_fit_t fit_proportional(int length_of_data, const long double x[], const long double y[], const long double w[]);
+
+// Fits y = coefficients[0] + sum(coefficients[k + 1] * regressors[k][i]) over the given
+// number of regressors, minimizing the weighted sum of the squared residuals (through the
+// normal equations around the weighted means). Without an intercept, coefficients[0] is
+// fixed at 0 (and the normal equations are taken around 0). Points with a weight of 0 (or
+// any NaN or infinite value) are ignored. Returns the weighted mean of the squared
+// residuals, or NaN when the regressors do not determine the coefficients.
+long double fit_linear_model(int length_of_data, int num_regressors, const long double* regressors[], const long double y[], 
+    const long double w[], long double coefficients[], bool intercept=true);
+
+// The sums behind fit_line and fit_proportional, updated one point at a time. The line is
+// kept as weighted running means and co-moments around them (so that large x do not lose
+// precision), and the proportional fit as the weighted sums around 0. Start from {}.
+typedef struct online_fit{
+    long double sum_of_weights;
+    long double mean_x;
+    long double mean_y;
+    long double cxx; // sum(w (x - mean_x)^2)
+    long double cxy; // sum(w (x - mean_x)(y - mean_y))
+    long double cyy; // sum(w (y - mean_y)^2)
+    long double sxx; // sum(w x^2)
+    long double sxy; // sum(w x y)
+    long double syy; // sum(w y^2)
+} online_fit_t;
+
+// Adds a point to the sums (unusable points are ignored, as in fit_line).
+void add_point(online_fit_t& fit, long double x, long double y, long double w);
+
+// The same fits as fit_line and fit_proportional over every point added so far.
+linear_fit_t online_line(const online_fit_t& fit);
+linear_fit_t online_proportional(const online_fit_t& fit);
+
+#endif
@@ -0,0 +1,242 @@
+#include "levenberg_marquardt.h"
+#include <vector>
+#include <functional>
+#include <cmath>
+#include <assert.h>
+
+using namespace std;
+
+// a simple macro to quickly write scope
+#define lm(return_type) return_type levenberg_marquardt
+#define DEFAULT_ITERATIONS 100
+#define DEFAULT_TOLERANCE 1e-10
+#define DEFAULT_DELTA 1e-7
+#define INITIAL_DAMPING 1e-3
+#define MIN_DAMPING 1e-15
+#define MAX_DAMPING 1e15
+#define DAMPING_FACTOR 10
+
+// Solves A x = b for the n x n matrix A (row-major) with Gaussian elimination and partial
+// pivoting. A and b are overwritten. Returns false when A is singular.
+static bool solve_linear_system(int n, vector<long double>& A, vector<long double>& b, vector<long double>& x){
+    for(int col = 0; col < n; ++col){
+        int pivot = col;
+        for(int row = col + 1; row < n; ++row){
+            if(fabsl(A[row * n + col]) > fabsl(A[pivot * n + col])) pivot = row;
+        }
+        if(A[pivot * n + col] == 0 || isnan(A[pivot * n + col])) return false;
+
+        if(pivot != col){
+            for(int k = 0; k < n; ++k) swap(A[col * n + k], A[pivot * n + k]);
+            swap(b[col], b[pivot]);
+        }
+
+        for(int row = col + 1; row < n; ++row){
+            long double factor = A[row * n + col] / A[col * n + col];
+            for(int k = col; k < n; ++k) A[row * n + k] -= factor * A[col * n + k];
+            b[row] -= factor * b[col];
+        }
+    }
+
+    for(int row = n - 1; row >= 0; --row){
+        long double sum = b[row];
+        for(int k = row + 1; k < n; ++k) sum -= A[row * n + k] * x[k];
+        x[row] = sum / A[row * n + row];
+    }
+    return true;
+}
+
+// ----------- PRIVATE -----------
+lm(void)::init(residual_function_t residuals, int num_args, int num_residuals, int iterations){
+    assert(num_args > 0);
+    assert(num_residuals >= 0);
+    assert(iterations >= 0);
+    this->residuals = residuals;
+    this->jacobian = nullptr;
+    this->num_args = num_args;
+    this->num_residuals = num_residuals;
+    this->iterations = iterations;
+    this->tolerance = DEFAULT_TOLERANCE;
+    this->delta = DEFAULT_DELTA;
+    this->error = NAN;
+    this->evaluations = 0;
+    this->guess = vector<long double>(num_args, 0);
+}
+
+// The sum of the squared residuals at args (NaN residuals count as 0). r is filled in.
+lm(long double)::sum_of_squares(const vector<long double>& args, vector<long double>& r){
+    residuals(&args[0], &r[0]);
+    evaluations++;
+
+    long double sum = 0;
+    for(int i = 0; i < num_residuals; ++i){
+        if(isnan(r[i])) r[i] = 0;
+        sum += r[i] * r[i];
+    }
+    return sum;
+}
+
+// Fills in the jacobian at args, whose residuals are r (by forward differences when no
+// jacobian was given).
+lm(void)::solve_jacobian(const vector<long double>& args, const vector<long double>& r, vector<long double>& J){
+    if(jacobian){
+        jacobian(&args[0], &J[0]);
+        evaluations++;
+        for(int i = 0; i < num_residuals * num_args; ++i){
+            if(isnan(J[i]) || isinf(J[i])) J[i] = 0;
+        }
+        return;
+    }
+
+    vector<long double> shifted(args);
+    vector<long double> r_shifted(num_residuals);
+    for(int j = 0; j < num_args; ++j){
+        long double h = delta * (fabsl(args[j]) > 1 ? fabsl(args[j]) : 1);
+        shifted[j] = args[j] + h;
+        sum_of_squares(shifted, r_shifted);
+        shifted[j] = args[j];
+
+        for(int i = 0; i < num_residuals; ++i){
+            J[i * num_args + j] = (r_shifted[i] - r[i]) / h;
+            if(isnan(J[i * num_args + j]) || isinf(J[i * num_args + j])) J[i * num_args + j] = 0;
+        }
+    }
+}
+
+// Runs the damped iterations from args (which ends up at the guess they reached), and
+// returns the sum of the squared residuals there.
+lm(long double)::run_from(vector<long double>& args){
+    vector<long double> r(num_residuals);
+    vector<long double> next_r(num_residuals);
+    vector<long double> J(num_residuals * num_args);
+    vector<long double> JTJ(num_args * num_args);
+    vector<long double> JTr(num_args);
+    vector<long double> A(num_args * num_args);
+    vector<long double> b(num_args);
+    vector<long double> step(num_args);
+    vector<long double> next_args(num_args);
+    long double damping = INITIAL_DAMPING;
+    long double cost = sum_of_squares(args, r);
+    if(isnan(cost) || isinf(cost)) return cost;
+
+    for(int iteration = 0; iteration < iterations; ++iteration){
+        solve_jacobian(args, r, J);
+        for(int j = 0; j < num_args; ++j){
+            JTr[j] = 0;
+            for(int i = 0; i < num_residuals; ++i) JTr[j] += J[i * num_args + j] * r[i];
+            for(int k = 0; k <= j; ++k){
+                long double sum = 0;
+                for(int i = 0; i < num_residuals; ++i) sum += J[i * num_args + j] * J[i * num_args + k];
+                JTJ[j * num_args + k] = sum;
+                JTJ[k * num_args + j] = sum;
+            }
+        }
+
+        // grow the damping until a step lowers the sum (or the step vanishes).
+        bool improved = false;
+        long double next_cost = cost;
+        while(damping < MAX_DAMPING){
+            A = JTJ;
+            for(int j = 0; j < num_args; ++j){
+                long double diagonal = JTJ[j * num_args + j];
+                A[j * num_args + j] += damping * (diagonal > 0 ? diagonal : 1);
+                b[j] = -JTr[j];
+            }
+
+            if(solve_linear_system(num_args, A, b, step)){
+                for(int j = 0; j < num_args; ++j) next_args[j] = args[j] + step[j];
+                next_cost = sum_of_squares(next_args, next_r);
+                if(next_cost < cost){
+                    improved = true;
+                    break;
+                }
+            }
+            damping *= DAMPING_FACTOR;
+        }
+        if(!improved) break; // no damped step helps: we are at a minimum.
+
+        long double step_size = 0;
+        long double size = 0;
+        for(int j = 0; j < num_args; ++j){
+            step_size += step[j] * step[j];
+            size += next_args[j] * next_args[j];
+        }
+
+        long double reduction = cost - next_cost;
+        args = next_args;
+        r = next_r;
+        cost = next_cost;
+        damping = damping / DAMPING_FACTOR > MIN_DAMPING ? damping / DAMPING_FACTOR : MIN_DAMPING;
+
+        if(reduction <= tolerance * cost || sqrtl(step_size) <= tolerance * (sqrtl(size) + tolerance)) break;
+    }
+
+    return cost;
+}
+
+// ----------- PUBLIC -----------
+lm()::levenberg_marquardt(residual_function_t residuals, int func_argument_count, int residual_count){
+    init(residuals, func_argument_count, residual_count, DEFAULT_ITERATIONS);
+}
+
+lm()::levenberg_marquardt(residual_function_t residuals, int func_argument_count, int residual_count, int iterations){
+    init(residuals, func_argument_count, residual_count, iterations);
+}
+
+lm(void)::set_jacobian(jacobian_function_t jacobian){
+    this->jacobian = jacobian;
+}
+
+lm(void)::set_iterations(int iterations){
+    this->iterations = iterations;
+}
+
+lm(void)::set_tolerance(long double tolerance){
+    this->tolerance = tolerance;
+}
+
+lm(void)::set_delta(long double delta){
+    this->delta = delta;
+}
+
+lm(void)::set_guess(const long double* guess){
+    for(int i = 0; i < num_args; ++i){
+        this->guess[i] = guess[i];
+    }
+}
+
+lm(void)::add_start(const long double* start){
+    starts.push_back(vector<long double>(start, start + num_args));
+}
+
+lm(vector<long double>)::get_guess(){
+    return guess;
+}
+
+lm(long double)::get_error(){
+    return error;
+}
+
+lm(long long)::get_evaluations(){
+    return evaluations;
+}
+
+lm(vector<long double>)::run(){
+    if(num_residuals == 0) return get_guess();
+
+    vector<long double> best(guess);
+    long double best_error = run_from(best);
+
+    for(int k = 0; k < starts.size(); ++k){
+        vector<long double> args(starts[k]);
+        long double start_error = run_from(args);
+        if(start_error < best_error || isnan(best_error)){
+            best = args;
+            best_error = start_error;
+        }
+    }
+
+    guess = best;
+    error = best_error;
+    return get_guess();
+}
@@ -0,0 +1,54 @@
+#ifndef LEVENBERG_MARQUARDT
+#define LEVENBERG_MARQUARDT
+
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+// residuals(args, out) fills in out[i] for every one of the residuals at args.
+typedef function<void(const long double*, long double*)> residual_function_t;
+// jacobian(args, out) fills in out[i * num_args + j], the partial of residual i in args[j].
+typedef function<void(const long double*, long double*)> jacobian_function_t;
+
+// Damped least squares (Levenberg-Marquardt): minimizes the sum of the squared residuals.
+// Every iteration solves (J^T J + lambda diag(J^T J)) step = -J^T r, and lambda shrinks
+// after a step that lowers the sum and grows after one that does not, so the solver moves
+// between Gauss-Newton (fast near the minimum) and gradient descent (safe far from it).
+// It stops once a step changes the sum or the guess by less than the tolerance. Without a
+// jacobian, the partials are taken by forward differences. With more than one start
+// (see add_start), it runs from every start and keeps the guess with the lowest sum.
+class levenberg_marquardt{
+private:
+    residual_function_t residuals;
+    jacobian_function_t jacobian;
+    int num_args;
+    int num_residuals;
+    int iterations;
+    long double tolerance;
+    long double delta;
+    long double error;
+    long long evaluations;
+    vector<long double> guess;
+    vector<vector<long double>> starts;
+    void init(residual_function_t residuals, int num_args, int num_residuals, int iterations);
+    long double sum_of_squares(const vector<long double>& args, vector<long double>& r);
+    void solve_jacobian(const vector<long double>& args, const vector<long double>& r, vector<long double>& J);
+    long double run_from(vector<long double>& args);
+
+public:
+    levenberg_marquardt(residual_function_t residuals, int func_argument_count, int residual_count);
+    levenberg_marquardt(residual_function_t residuals, int func_argument_count, int residual_count, int iterations);
+    void set_jacobian(jacobian_function_t jacobian);
+    void set_iterations(int iterations);
+    void set_tolerance(long double tolerance);
+    void set_delta(long double delta);
+    void set_guess(const long double* guess);
+    void add_start(const long double* start);
+    vector<long double> get_guess();
+    long double get_error();        // the sum of the squared residuals at the guess
+    long long get_evaluations();    // how many times the residuals (or jacobian) were evaluated
+    vector<long double> run();
+};
+
+#endif
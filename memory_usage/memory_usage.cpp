@@ -0,0 +1,151 @@
+#include "memory_usage.h"
+#include <errno.h>
+#include <stddef.h>
+#include <sys/resource.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+// glibc lets a program replace malloc as long as it provides all of the functions below;
+// each of them forwards to the allocator in glibc and counts the bytes the calling thread
+// holds while tracking is on.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+void __libc_free(void* ptr);
+}
+
+// whether this process measures (see memory_usage::enable). Checked before the thread-local
+// state, so a process that does not measure never touches it.
+static bool enabled = false;
+
+static __thread bool tracking __attribute__((tls_model("initial-exec"))) = false;
+static __thread long long held __attribute__((tls_model("initial-exec"))) = 0;
+static __thread long long peak __attribute__((tls_model("initial-exec"))) = 0;
+static __thread long long allocations __attribute__((tls_model("initial-exec"))) = 0;
+
+static void* allocated(void* ptr){
+    if(enabled && tracking && ptr != nullptr){
+        held += malloc_usable_size(ptr);
+        if(held > peak) peak = held;
+        allocations++;
+    }
+    return ptr;
+}
+
+// A block that was allocated before start() was never added to held, so held stops at 0
+// (otherwise freeing it would hide as many bytes of the blocks allocated after it from peak).
+static void releasing(void* ptr){
+    if(enabled && tracking && ptr != nullptr){
+        held -= malloc_usable_size(ptr);
+        if(held < 0) held = 0;
+    }
+}
+
+extern "C" {
+void* malloc(size_t size){
+    return allocated(__libc_malloc(size));
+}
+
+void* calloc(size_t count, size_t size){
+    return allocated(__libc_calloc(count, size));
+}
+
+void* realloc(void* ptr, size_t size){
+    releasing(ptr);
+    void* moved = __libc_realloc(ptr, size);
+    // a failed realloc leaves the old block in place.
+    if(moved == nullptr && size != 0) return allocated(ptr);
+    return allocated(moved);
+}
+
+void* memalign(size_t alignment, size_t size){
+    return allocated(__libc_memalign(alignment, size));
+}
+
+void* aligned_alloc(size_t alignment, size_t size){
+    return allocated(__libc_memalign(alignment, size));
+}
+
+void* valloc(size_t size){
+    return allocated(__libc_valloc(size));
+}
+
+void* pvalloc(size_t size){
+    return allocated(__libc_pvalloc(size));
+}
+
+void* reallocarray(void* ptr, size_t count, size_t size){
+    size_t bytes;
+    if(__builtin_mul_overflow(count, size, &bytes)){
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(ptr, bytes);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size){
+    void* block = __libc_memalign(alignment, size);
+    if(block == nullptr) return ENOMEM;
+    *ptr = allocated(block);
+    return 0;
+}
+
+void free(void* ptr){
+    releasing(ptr);
+    __libc_free(ptr);
+}
+}
+#endif
+
+// The peak resident set size of the process in bytes.
+static long long peak_rss(){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss; // already in bytes
+#else
+    return (long long) usage.ru_maxrss * 1024;
+#endif
+}
+
+// ----------- PUBLIC -----------
+bool memory_usage::available(){
+#ifdef __GLIBC__
+    return true;
+#else
+    return false;
+#endif
+}
+
+void memory_usage::enable(){
+#ifdef __GLIBC__
+    enabled = true;
+#endif
+}
+
+void memory_usage::start(){
+    rss_before = peak_rss();
+#ifdef __GLIBC__
+    held = 0;
+    peak = 0;
+    allocations = 0;
+    tracking = true;
+#endif
+}
+
+void memory_usage::stop(long long& peak_heap_bytes, long long& allocation_count, long long& peak_rss_bytes){
+#ifdef __GLIBC__
+    tracking = false;
+    peak_heap_bytes = peak;
+    allocation_count = allocations;
+#else
+    peak_heap_bytes = -1;
+    allocation_count = -1;
+#endif
+    peak_rss_bytes = peak_rss() - rss_before;
+}
@@ -0,0 +1,25 @@
+#ifndef MEMORY_USAGE
+#define MEMORY_USAGE
+
+// Memory used by the calling thread between start() and stop(): the peak number of heap
+// bytes held above what was held at start() (freeing a block from before start() does not
+// make room for later ones), the number of allocations, and how much the
+// peak resident set size of the process grew. Heap usage is counted by interposing malloc
+// (glibc only); elsewhere the heap figures read -1. The peak resident set size only grows
+// over the life of a process, so it is only meaningful in a freshly forked process.
+// Allocations are only counted in a process that measures (see enable): everywhere else,
+// such as the tester itself and its fitter threads, the replaced allocator only forwards to glibc.
+class memory_usage{
+private:
+    long long rss_before;
+
+public:
+    static bool available();
+    // Counts the allocations of this process from now on (between start() and stop() of a
+    // thread). Called by the process that measures samples, before its first sample.
+    static void enable();
+    void start();
+    void stop(long long& peak_heap_bytes, long long& allocations, long long& peak_rss_bytes);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "operation_timer.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define OPERATION_BUFFER 65536  // timestamps per thread before the buffer is folded
+
+// a negative timestamp starts an operation without ending one.
+static __thread long long* timestamps = nullptr;
+static __thread int used = 0;
+static __thread bool timing = false;
+static __thread long long previous = 0;
+static __thread long long operations = 0;
+static __thread long long worst = 0;
+
+static long long now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Folds the timestamps in the buffer into the number of operations and the longest one.
+static void fold(){
+    for(int i = 0; i < used; ++i){
+        if(timestamps[i] < 0){
+            previous = -timestamps[i];
+            continue;
+        }
+        if(timestamps[i] - previous > worst) worst = timestamps[i] - previous;
+        previous = timestamps[i];
+        operations++;
+    }
+    used = 0;
+}
+
+static void mark(long long timestamp){
+    timestamps[used++] = timestamp;
+    if(used < OPERATION_BUFFER) return;
+
+    fold();
+    // the next operation starts once the buffer is empty again.
+    timestamps[used++] = -now();
+}
+
+void operation_done(){
+    if(timing) mark(now());
+}
+
+void operation_begin(){
+    if(timing) mark(-now());
+}
+
+void operation_timer::start(){
+    if(timestamps == nullptr) timestamps = (long long*) malloc(sizeof(long long) * OPERATION_BUFFER);
+    used = 0;
+    operations = 0;
+    worst = 0;
+    previous = now();
+    timing = timestamps != nullptr;
+}
+
+void operation_timer::stop(long long& operations, long long& worst_nanoseconds){
+    if(timing) fold();
+    timing = false;
+    operations = ::operations;
+    worst_nanoseconds = worst;
+}
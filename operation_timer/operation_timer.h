@@ -0,0 +1,22 @@
+#ifndef OPERATION_TIMER
+#define OPERATION_TIMER
+
+// Marks the end of one operation of the function under test (see time_complexity::per_operation).
+// The operation started at the previous mark, or at the start of the call.
+void operation_done();
+// Starts the next operation here, without counting the work since the previous mark (such as
+// the setup of a call) as an operation.
+void operation_begin();
+
+// Times the operations of the calling thread between start() and stop(). Every mark stores
+// one timestamp into a buffer that is allocated once per thread, so that marking an operation
+// neither allocates nor compares. The buffer is folded into the number of operations and the
+// longest one whenever it fills up (the time spent folding does not count towards any
+// operation) and at stop(). Marks outside of start() and stop() are ignored.
+class operation_timer{
+public:
+    void start();
+    void stop(long long& operations, long long& worst_nanoseconds);
+};
+
+#endif
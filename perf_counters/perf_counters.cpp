@@ -0,0 +1,85 @@
+#include "perf_counters.h"
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __linux__
+static const unsigned long long events[NUM_PERF_COUNTERS] = {
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+// what read() returns with PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+typedef struct counter_reading{
+    unsigned long long value;
+    unsigned long long time_enabled;
+    unsigned long long time_running;
+} counter_reading_t;
+#endif
+
+// ----------- PUBLIC -----------
+perf_counters::perf_counters(){
+    for(int i = 0; i < NUM_PERF_COUNTERS; ++i){
+        fds[i] = -1;
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = events[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // pid = 0, cpu = -1: the calling thread, on whichever cpu it runs.
+        fds[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+}
+
+perf_counters::~perf_counters(){
+    for(int i = 0; i < NUM_PERF_COUNTERS; ++i){
+        if(fds[i] >= 0) close(fds[i]);
+    }
+}
+
+bool perf_counters::available(){
+    for(int i = 0; i < NUM_PERF_COUNTERS; ++i){
+        if(fds[i] >= 0) return true;
+    }
+    return false;
+}
+
+void perf_counters::start(){
+#ifdef __linux__
+    for(int i = 0; i < NUM_PERF_COUNTERS; ++i){
+        if(fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+// Stops counting and writes the events counted since start() into values (-1 for a
+// counter we could not open). Counts are scaled up when the kernel had to multiplex.
+void perf_counters::stop(long long values[NUM_PERF_COUNTERS]){
+    for(int i = 0; i < NUM_PERF_COUNTERS; ++i){
+        values[i] = -1;
+#ifdef __linux__
+        if(fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        counter_reading_t reading;
+        if(read(fds[i], &reading, sizeof(reading)) != sizeof(reading) || reading.time_running == 0) continue;
+
+        values[i] = (long long) ((long double) reading.value * reading.time_enabled / reading.time_running);
+#endif
+    }
+}
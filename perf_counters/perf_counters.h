@@ -0,0 +1,30 @@
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS
+
+#define NUM_PERF_COUNTERS 4
+
+// The order of the counters in perf_counters::stop (and dd_t::counters).
+#define INSTRUCTIONS_COUNTER 0
+#define CYCLES_COUNTER 1
+#define CACHE_MISSES_COUNTER 2
+#define BRANCH_MISSES_COUNTER 3
+
+// Hardware performance counters (instructions retired, cycles, cache misses and branch
+// misses) of the calling thread, read through perf_event_open. Only user-space events
+// are counted. On systems without perf events (or when perf_event_paranoid does not
+// allow them) every counter reads -1.
+class perf_counters{
+private:
+    int fds[NUM_PERF_COUNTERS];
+
+public:
+    perf_counters();
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+    ~perf_counters();
+    bool available();
+    void start();
+    void stop(long long values[NUM_PERF_COUNTERS]);
+};
+
+#endif
@@ -0,0 +1,22 @@
+// The standard headers that submitted programs include most often. Generated tests are
+// compiled with -include precompiled/common.h, so that GCC loads the precompiled
+// common.h.gch (make library) instead of parsing these headers for every test. It is only
+// used when it was built with the same flags as the test.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
@@ -2,6 +2,7 @@ import matplotlib.pyplot as plt
 import sys
 import os
 import json
+import result_file
 
 
 color_map = {"O(1)":"cornflowerblue", "O(log n)": "deepskyblue", "O(sqrt(n))":"darkturquoise",
@@ -43,7 +44,7 @@ def generate_scatterplot(name:str, data) -> None:
 if __name__ == "__main__":
     # If the user does not pass the correct number of arguments:
     if len(sys.argv) != 2:
-        print("Correct usage: python data_visualizer.py [PATH-TO-JSON-FILE]")
+        print("Correct usage: python data_visualizer.py [PATH-TO-JSON-OR-RESULT-FILE]")
         exit(1)
     
     # Otherwise check if the file exists:
@@ -55,10 +56,14 @@ if __name__ == "__main__":
         print("Path does not point to a file!")
         exit(1)
     
-    # Attempt to parse through the file using json
-    read_file = open(path, "r")
-    data = json.load(read_file)
-    read_file.close()
+    # A result file holds every run of a test: plot the time fit of the last run.
+    if path.endswith(".tcr"):
+        data = result_file.to_json(result_file.ResultFile(path).runs[-1]["fits"][0])
+    else:
+        # Attempt to parse through the file using json
+        read_file = open(path, "r")
+        data = json.load(read_file)
+        read_file.close()
 
     generate_scatterplot(path, data["data"])
 
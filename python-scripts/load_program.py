@@ -2,16 +2,21 @@ import subprocess as sp
 import argparse
 import sys
 import os
+import re
 
 TEST_FLAG : str = "// ~TC-TEST~"
 TC_PATH : str = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/time_complexity.h"
 TIME_COMPLEXITY_INCLUDE : str = f"#include \"{TC_PATH}\"\n"
+# The slim header (see time_complexity_slim.h), for tests linked against the prebuilt library:
+TC_SLIM_PATH : str = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/time_complexity_slim/time_complexity_slim.h"
+TIME_COMPLEXITY_SLIM_INCLUDE : str = f"#include \"{TC_SLIM_PATH}\"\n"
 MAIN_FN_START : str = "\n\nint main(){\n"
 MAIN_FN_END : str = "}"
 DEFAULT_BUDGET : int = 5000
+IDENTIFIER : str = r"[A-Za-z_][A-Za-z0-9_]*"
 
 # Generates the C++ code for the test.
-def generate_tester(name : str, budget : int, program : str) -> str:
+def generate_tester(name : str, budget : int, program : str, slim : bool = False) -> str:
     program.replace("\\n", "\n") # replace all "\n" with actual new-lines
 
     # If the program already has the main function, prints an error:
@@ -40,12 +45,16 @@ def generate_tester(name : str, budget : int, program : str) -> str:
         while program[start_of_name] == " ": start_of_name += 1 # increment while there is a space
         end_of_name : int = program.find("\n", start_of_name)
 
-        # the function can return anything:
-        fn_start : int = program.find(" ", end_of_name + 1)
-        fn_end : int = program.find("(", fn_start)
-
-        # the name of the function:
-        function_name : str = program[fn_start:fn_end]
+        # the function can return anything (even several words, like "unsigned long long"),
+        # so its name is the identifier right before the "(":
+        fn_end : int = program.find("(", end_of_name + 1)
+        declaration = program[end_of_name + 1:fn_end].split() if fn_end != -1 else []
+        function_name : str = declaration[-1].lstrip("*&") if len(declaration) > 1 else ""
+        if re.fullmatch(IDENTIFIER, function_name) is None:
+            print("Cannot find the name of the function after \"" + program[index:end_of_name]
+                + "\". Please write \"" + TEST_FLAG + " [NAME-OF-TEST]\" on the line right before "
+                + "a function of one int (for example \"long long f(int n)\").", file=sys.stderr)
+            exit(1)
         
         # the name of the test:
         if start_of_name == end_of_name:
@@ -53,15 +62,20 @@ def generate_tester(name : str, budget : int, program : str) -> str:
         else:
             test_name : str = program[start_of_name:end_of_name]
 
-        tests.append(f"    tc.compute_complexity(\"{test_name}\", {function_name});\n")
+        if slim: # the slim tester takes a function pointer, so wrap the call in a lambda
+            tests.append(f"    tc.compute_complexity(\"{test_name}\", [](int n) {{{function_name}(n);}});\n")
+        else:
+            tests.append(f"    tc.compute_complexity(\"{test_name}\", {function_name});\n")
 
         index = program.find(TEST_FLAG, start_index) # move the loop forward
     
     tests_str : str = "".join(tests)
-    main_func : str = "".join([MAIN_FN_START, f"    time_complexity tc({budget});\n",
-        f"    tc.auto_interval = false;\n", tests_str, MAIN_FN_END])
+    tester : str = "slim_time_complexity" if slim else "time_complexity"
+    main_func : str = "".join([MAIN_FN_START, f"    {tester} tc({budget});\n",
+        f"    tc.auto_interval = false;\n", f"    tc.calibrate = true;\n", tests_str, MAIN_FN_END])
 
-    return "".join([TIME_COMPLEXITY_INCLUDE, program, main_func])
+    include : str = TIME_COMPLEXITY_SLIM_INCLUDE if slim else TIME_COMPLEXITY_INCLUDE
+    return "".join([include, program, main_func])
 
 # Writes the code to a test file:
 def write_to_file(dir : str, name : str, program : str):
@@ -93,12 +107,14 @@ if __name__ == "__main__":
 
     parser.add_argument("-d", "--directory", type=str, default=".", help="The parent directory \
         of the parsed program.")
+    parser.add_argument("-s", "--slim", action="store_true", help="include the slim \
+        header and link against the prebuilt library (make library) instead of the full tester.")
     parser.add_argument("name", metavar="NAME", type=str, help="the name of the C/C++ program.")
     parser.add_argument("time_budget", metavar="TIME-BUDGET", type=int, default=DEFAULT_BUDGET, help="how long the tester runs for")
     parser.add_argument("program", metavar="PROGRAM", nargs="+", type=str, help="the C/C++ program.")
 
     args = parser.parse_args()
 
-    test_program : str = generate_tester(args.name, args.time_budget, " ".join(args.program))
+    test_program : str = generate_tester(args.name, args.time_budget, " ".join(args.program), args.slim)
 
     write_to_file(args.directory, args.name, test_program)
\ No newline at end of file
@@ -0,0 +1,127 @@
+import mmap
+import struct
+import sys
+import os
+import json
+import math
+
+# Reads the binary result files (results.tcr) that the time complexity tester appends every
+# run of a test to (see result_file/result_file.h for the layout). The columns are memoryviews
+# straight into the mapped file, so nothing is parsed or copied until it is used.
+
+MAGIC : bytes = b"TCRESULT"
+HEADER_SIZE : int = 16
+BLOCK_HEADER = struct.Struct("=IIQQ") # kind, rows, run, bytes
+RUN_BLOCK, SAMPLES_BLOCK, RESET_BLOCK, FIT_BLOCK = 1, 2, 3, 4
+SAMPLE_COLUMNS = ["n", "iterations", "duration", "instructions", "cycles", "cache_misses", "branch_misses",
+    "heap_bytes", "allocations", "rss_bytes", "operations", "worst_operation"]
+RUN_FIELDS = ["created", "total_budget", "computation_budget", "trials", "calibrate", "cost_metric", "space_metric", "fit_solver"]
+LEAST_SQUARES_FIT : int = 1
+FUNCTION_STR : str = "2(a - 1)(1 / [1+e^(-(x-c)/(d x sigmoid(b)))] - 0.5) + 1"
+LEAST_SQUARES_STR : str = "a + b f(n)"
+
+# Reads a payload in the order it was written: 8-byte values, strings and columns.
+class Payload:
+    def __init__(self, view : memoryview):
+        self.view = view
+        self.at = 0
+
+    def column(self, rows : int, kind : str) -> memoryview:
+        length = rows * 8
+        if self.at + length > len(self.view):
+            raise ValueError("cut off block")
+        column = self.view[self.at:self.at + length].cast(kind)
+        self.at += length
+        return column
+
+    def integer(self) -> int:
+        return self.column(1, "q")[0]
+
+    def string(self) -> str:
+        length = self.integer()
+        text = bytes(self.view[self.at:self.at + length]).decode("utf8")
+        self.at += (length + 7) // 8 * 8
+        return text
+
+class ResultFile:
+    def __init__(self, path : str):
+        self.file = open(path, "rb")
+        self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        if self.map[:len(MAGIC)] != MAGIC:
+            raise ValueError(path + " is not a result file")
+        self.runs = []
+        self.read_blocks(memoryview(self.map))
+
+    def read_blocks(self, view : memoryview) -> None:
+        at = HEADER_SIZE
+        runs = {}
+        while at + BLOCK_HEADER.size <= len(view):
+            kind, rows, run_id, size = BLOCK_HEADER.unpack_from(view, at)
+            at += BLOCK_HEADER.size
+            if at + size > len(view):
+                break # a block that is still being appended
+            payload = Payload(view[at:at + size])
+            at += size
+
+            try:
+                if kind == RUN_BLOCK:
+                    run = {"id": run_id, "name": payload.string(), "samples": [], "fits": []}
+                    for field in RUN_FIELDS:
+                        run[field] = payload.integer()
+                    runs[run_id] = run
+                    self.runs.append(run)
+                elif run_id not in runs:
+                    continue
+                elif kind == SAMPLES_BLOCK:
+                    runs[run_id]["samples"].append({name: payload.column(rows, "q" if i < 2 else "d")
+                        for i, name in enumerate(SAMPLE_COLUMNS)})
+                elif kind == RESET_BLOCK:
+                    runs[run_id]["samples"] = []
+                elif kind == FIT_BLOCK:
+                    runs[run_id]["fits"].append(self.read_fit(payload, rows))
+            except ValueError:
+                continue
+
+    def read_fit(self, payload : Payload, rows : int) -> dict:
+        fit = {"name": payload.string()}
+        for field in ["metric", "solver", "st", "end"]:
+            fit[field] = payload.integer()
+        num_functions = payload.integer()
+        fit["functions"] = [payload.string() for _ in range(num_functions)]
+        for field in ["a", "b", "c", "d", "error"]:
+            fit[field] = payload.column(num_functions, "d")
+        fit["found"] = payload.column(num_functions, "q")
+        fit["n"] = payload.column(rows, "d")
+        fit["ratios"] = [payload.column(rows, "d") for _ in range(num_functions)]
+        return fit
+
+# The number, or None (null in JSON) when it is not finite, as the tester writes it.
+def finite_or_none(x : float):
+    return x if math.isfinite(x) else None
+
+# The fit in the JSON format that the tester saves ({"predictions": ..., "data": ...}).
+def to_json(fit : dict) -> dict:
+    predictions = {"function string": LEAST_SQUARES_STR if fit["solver"] == LEAST_SQUARES_FIT else FUNCTION_STR}
+    data = {}
+    for i, name in enumerate(fit["functions"]):
+        guess = [finite_or_none(fit["a"][i]), finite_or_none(fit["b"][i]), int(fit["c"][i]), finite_or_none(fit["d"][i])]
+        predictions[name] = {"guess": guess, "error": finite_or_none(fit["error"][i])}
+        rows = [j for j, ratio in enumerate(fit["ratios"][i]) if math.isfinite(ratio)] # leaves out NaN and infinity
+        data[name] = {"x": [int(fit["n"][j]) for j in rows], "y": [fit["ratios"][i][j] for j in rows]}
+    return {"predictions": predictions, "data": data}
+
+
+# The main driver: prints a fit of a run as JSON.
+if __name__ == "__main__":
+    if len(sys.argv) < 2 or len(sys.argv) > 4:
+        print("Correct usage: python result_file.py [PATH-TO-RESULT-FILE] [RUN (default: the last)] [FIT (default: 0)]")
+        exit(1)
+
+    path : str = sys.argv[1]
+    if not os.path.isfile(path):
+        print("Path does not point to a file!")
+        exit(1)
+
+    results = ResultFile(path)
+    run = results.runs[int(sys.argv[2]) if len(sys.argv) > 2 else -1]
+    print(json.dumps(to_json(run["fits"][int(sys.argv[3]) if len(sys.argv) > 3 else 0])))
@@ -0,0 +1,35 @@
+import unittest
+import io
+import contextlib
+from load_program import generate_tester, TEST_FLAG
+
+# python3 -m unittest test_load_program (from python-scripts)
+class GenerateTesterTest(unittest.TestCase):
+    def generate(self, program : str, slim : bool):
+        return generate_tester("test", 100, program, slim)
+
+    def test_single_word_return_type(self):
+        program = f"{TEST_FLAG} lin\nint f(int n){{ return n; }}\n"
+        self.assertIn('tc.compute_complexity("lin", [](int n) {f(n);});', self.generate(program, True))
+        self.assertIn('tc.compute_complexity("lin", f);', self.generate(program, False))
+
+    def test_multi_word_return_type(self):
+        for declaration in ["long long f(int n)", "unsigned int f(int n)", "static int f(int n)",
+                "static inline unsigned long long f (int n)", "const char* f(int n)", "int *f(int n)"]:
+            program = f"{TEST_FLAG} lin\n{declaration}{{ return 0; }}\n"
+            self.assertIn('tc.compute_complexity("lin", [](int n) {f(n);});', self.generate(program, True), declaration)
+            self.assertIn('tc.compute_complexity("lin", f);', self.generate(program, False), declaration)
+
+    def test_unnamed_test(self):
+        program = f"{TEST_FLAG}\nlong long fib(int n){{ return n; }}\n"
+        self.assertIn('tc.compute_complexity("fib", [](int n) {fib(n);});', self.generate(program, True))
+
+    def test_rejects_what_is_not_a_function(self):
+        for declaration in ["int x = 5;\n", "void (int n){}\n", "auto g = [](int n){};\n"]:
+            program = f"{TEST_FLAG} lin\n{declaration}"
+            with contextlib.redirect_stderr(io.StringIO()):
+                with self.assertRaises(SystemExit, msg=declaration):
+                    self.generate(program, True)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,326 @@
+#include "result_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RESULT_BLOCK_ROWS 64 // samples per SAMPLES_BLOCK while a run is sampling
+#define RESULT_HEADER_SIZE 16
+
+// The payload of a block as it is built: 8-byte values, strings and columns.
+class payload_builder{
+public:
+    vector<char> bytes;
+
+    void put(const void* data, size_t length){
+        bytes.insert(bytes.end(), (const char*) data, (const char*) data + length);
+        bytes.resize((bytes.size() + 7) / 8 * 8, 0);
+    }
+
+    void put(int64_t value){
+        put(&value, sizeof(value));
+    }
+
+    void put(double value){
+        put(&value, sizeof(value));
+    }
+
+    void put(const string& value){
+        put((int64_t) value.size());
+        put(value.data(), value.size());
+    }
+};
+
+// Reads a payload in the order it was built. Every read fails (returns false) past the end.
+class payload_parser{
+private:
+    const char* at;
+    const char* end;
+
+public:
+    payload_parser(const char* at, size_t length) : at(at), end(at + length) {}
+
+    template<typename T> bool column(int rows, const T*& out){
+        size_t length = (size_t) rows * sizeof(T);
+        if(end - at < (ptrdiff_t) length) return false;
+        out = (const T*) at;
+        at += (length + 7) / 8 * 8;
+        return true;
+    }
+
+    bool get(int64_t& value){
+        const int64_t* p;
+        if(!column(1, p)) return false;
+        value = *p;
+        return true;
+    }
+
+    bool get(string& value){
+        int64_t length;
+        const char* p;
+        if(!get(length) || length < 0 || !column((int) length, p)) return false;
+        value.assign(p, length);
+        return true;
+    }
+};
+
+// ------------------------ SAMPLES ------------------------
+dd_t result_samples::sample(int row) const {
+    // a raw sample: its trials are not combined yet.
+    dd_t result = {(int) n[row], duration[row], iterations[row], {}, heap_bytes[row], allocations[row], rss_bytes[row],
+        operations[row], worst_operation[row], 0, 0, 0, 0};
+    for(int k = 0; k < NUM_PERF_COUNTERS; ++k) result.counters[k] = counters[k][row];
+    return result;
+}
+
+// ------------------------ WRITER ------------------------
+result_writer::result_writer(string path, const result_run_t& settings){
+    // the writer that creates the file writes its header.
+    fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if(fd >= 0){
+        char header[RESULT_HEADER_SIZE] = {0};
+        uint32_t version = RESULT_VERSION;
+        memcpy(header, RESULT_MAGIC, 8);
+        memcpy(header + 8, &version, sizeof(version));
+        if(write(fd, header, sizeof(header)) != sizeof(header)){
+            close(fd);
+            fd = -1;
+        }
+    }else{
+        fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    run = ((uint64_t) now.tv_sec * 1000000000 + now.tv_nsec) ^ ((uint64_t) getpid() << 40);
+
+    payload_builder payload;
+    payload.put(settings.name);
+    payload.put((int64_t) now.tv_sec);
+    payload.put(settings.total_budget);
+    payload.put(settings.computation_budget);
+    payload.put(settings.trials);
+    payload.put(settings.calibrate);
+    payload.put(settings.cost_metric);
+    payload.put(settings.space_metric);
+    payload.put(settings.fit_solver);
+    append(RUN_BLOCK, 0, payload.bytes);
+}
+
+result_writer::~result_writer(){
+    flush_samples();
+    if(fd >= 0) close(fd);
+}
+
+bool result_writer::usable(){
+    return fd >= 0;
+}
+
+void result_writer::append(uint32_t kind, uint32_t rows, const vector<char>& payload){
+    if(fd < 0) return;
+    vector<char> block(sizeof(result_block_t) + payload.size());
+    result_block_t header = {kind, rows, run, payload.size()};
+    memcpy(&block[0], &header, sizeof(header));
+    if(!payload.empty()) memcpy(&block[sizeof(header)], &payload[0], payload.size());
+
+    // a failed write leaves the file as it was (or with a cut off block, which readers skip).
+    if(write(fd, &block[0], block.size()) != (ssize_t) block.size()){
+        close(fd);
+        fd = -1;
+    }
+}
+
+void result_writer::flush_samples(){
+    if(pending.empty()) return;
+    int rows = pending.size();
+    payload_builder payload;
+    for(int i = 0; i < rows; ++i) payload.put((int64_t) pending[i].n);
+    for(int i = 0; i < rows; ++i) payload.put((int64_t) pending[i].iterations);
+    for(int i = 0; i < rows; ++i) payload.put((double) pending[i].duration);
+    for(int k = 0; k < NUM_PERF_COUNTERS; ++k){
+        for(int i = 0; i < rows; ++i) payload.put((double) pending[i].counters[k]);
+    }
+    for(int i = 0; i < rows; ++i) payload.put((double) pending[i].heap_bytes);
+    for(int i = 0; i < rows; ++i) payload.put((double) pending[i].allocations);
+    for(int i = 0; i < rows; ++i) payload.put((double) pending[i].rss_bytes);
+    for(int i = 0; i < rows; ++i) payload.put((double) pending[i].operations);
+    for(int i = 0; i < rows; ++i) payload.put((double) pending[i].worst_operation);
+    append(SAMPLES_BLOCK, rows, payload.bytes);
+    pending.clear();
+}
+
+void result_writer::add_sample(const dd_t& sample){
+    lock_guard<mutex> guard(lock);
+    pending.push_back(sample);
+    if(pending.size() >= RESULT_BLOCK_ROWS) flush_samples();
+}
+
+void result_writer::reset(){
+    lock_guard<mutex> guard(lock);
+    pending.clear();
+    append(RESET_BLOCK, 0, vector<char>());
+}
+
+void result_writer::add_fit(const result_fit_t& fit){
+    lock_guard<mutex> guard(lock);
+    flush_samples();
+
+    int num_functions = fit.functions.size();
+    payload_builder payload;
+    payload.put(fit.name);
+    payload.put(fit.metric);
+    payload.put(fit.solver);
+    payload.put(fit.st);
+    payload.put(fit.end);
+    payload.put((int64_t) num_functions);
+    for(int i = 0; i < num_functions; ++i) payload.put(fit.functions[i]);
+    const double* guesses[5] = {fit.a, fit.b, fit.c, fit.d, fit.error};
+    for(int k = 0; k < 5; ++k) payload.put(guesses[k], sizeof(double) * num_functions);
+    payload.put(fit.found, sizeof(int64_t) * num_functions);
+    payload.put(fit.n, sizeof(double) * fit.rows);
+    for(int i = 0; i < num_functions; ++i) payload.put(fit.ratios[i], sizeof(double) * fit.rows);
+    append(FIT_BLOCK, fit.rows, payload.bytes);
+}
+
+// ------------------------ READER ------------------------
+// Points the columns of a SAMPLES_BLOCK into the payload.
+static bool parse_samples(payload_parser& parser, int rows, result_samples_t& samples){
+    samples.rows = rows;
+    bool ok = parser.column(rows, samples.n) && parser.column(rows, samples.iterations) && parser.column(rows, samples.duration);
+    for(int k = 0; k < NUM_PERF_COUNTERS; ++k) ok = ok && parser.column(rows, samples.counters[k]);
+    return ok && parser.column(rows, samples.heap_bytes) && parser.column(rows, samples.allocations) && parser.column(rows, samples.rss_bytes)
+        && parser.column(rows, samples.operations) && parser.column(rows, samples.worst_operation);
+}
+
+static bool parse_fit(payload_parser& parser, int rows, result_fit_t& fit){
+    int64_t num_functions;
+    if(!parser.get(fit.name) || !parser.get(fit.metric) || !parser.get(fit.solver) || !parser.get(fit.st) || !parser.get(fit.end)
+        || !parser.get(num_functions) || num_functions < 0) return false;
+    fit.functions.resize(num_functions);
+    for(int i = 0; i < num_functions; ++i){
+        if(!parser.get(fit.functions[i])) return false;
+    }
+    fit.rows = rows;
+    if(!parser.column(num_functions, fit.a) || !parser.column(num_functions, fit.b) || !parser.column(num_functions, fit.c)
+        || !parser.column(num_functions, fit.d) || !parser.column(num_functions, fit.error) || !parser.column(num_functions, fit.found)
+        || !parser.column(rows, fit.n)) return false;
+    fit.ratios.resize(num_functions);
+    for(int i = 0; i < num_functions; ++i){
+        if(!parser.column(rows, fit.ratios[i])) return false;
+    }
+    return true;
+}
+
+result_reader::result_reader(string path){
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return;
+    struct stat info;
+    if(fstat(fd, &info) == 0 && info.st_size >= RESULT_HEADER_SIZE){
+        size = info.st_size;
+        map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED) map = nullptr;
+    }
+    close(fd);
+    if(map == nullptr || memcmp(map, RESULT_MAGIC, 8) != 0) return;
+
+    const char* at = (const char*) map + RESULT_HEADER_SIZE;
+    const char* end = (const char*) map + size;
+    while(end - at >= (ptrdiff_t) sizeof(result_block_t)){
+        result_block_t block;
+        memcpy(&block, at, sizeof(block));
+        at += sizeof(block);
+        if((uint64_t) (end - at) < block.bytes) break;
+        payload_parser parser(at, block.bytes);
+        at += block.bytes;
+
+        if(block.kind == RUN_BLOCK){
+            result_run_t run = {block.run, "", 0, 0, 0, 0, 0, 0, 0, 0, {}, {}};
+            if(parser.get(run.name) && parser.get(run.created) && parser.get(run.total_budget) && parser.get(run.computation_budget)
+                && parser.get(run.trials) && parser.get(run.calibrate) && parser.get(run.cost_metric) && parser.get(run.space_metric)
+                && parser.get(run.fit_solver)) runs.push_back(run);
+            continue;
+        }
+
+        // the blocks of a run follow its RUN_BLOCK.
+        result_run_t* run = nullptr;
+        for(int i = runs.size() - 1; i >= 0 && run == nullptr; --i){
+            if(runs[i].id == block.run) run = &runs[i];
+        }
+        if(run == nullptr) continue;
+
+        if(block.kind == SAMPLES_BLOCK){
+            result_samples_t samples;
+            if(parse_samples(parser, block.rows, samples)) run->samples.push_back(samples);
+        }else if(block.kind == RESET_BLOCK){
+            run->samples.clear();
+        }else if(block.kind == FIT_BLOCK){
+            result_fit_t fit;
+            if(parse_fit(parser, block.rows, fit)) run->fits.push_back(fit);
+        }
+    }
+}
+
+result_reader::~result_reader(){
+    if(map != nullptr) munmap(map, size);
+}
+
+bool result_reader::usable(){
+    return map != nullptr && memcmp(map, RESULT_MAGIC, 8) == 0;
+}
+
+// ------------------------ JSON ------------------------
+// Writes the number, or null when it is not finite (JSON has no NaN or infinity).
+static void write_number(ostream& out, double x){
+    if(isnan(x) || isinf(x)) out << "null";
+    else out << x;
+}
+
+void export_json(const result_fit_t& fit, ostream& out){
+    int num_functions = fit.functions.size();
+
+    out << "{";
+
+    // Write guess:
+    out << "\"predictions\":{";
+    out << "\"function string\":\"" << (fit.solver == LEAST_SQUARES_FIT ? LEAST_SQUARES_STR : FUNCTION_STR) << "\",";
+    for(int function_num = 0; function_num < num_functions; ++function_num){ // for each function:
+        out << "\"" << fit.functions[function_num] << "\":{";
+        out << "\"guess\":[";
+        write_number(out, fit.a[function_num]);
+        out << ",";
+        write_number(out, fit.b[function_num]);
+        out << "," << (int) fit.c[function_num] << ",";
+        write_number(out, fit.d[function_num]);
+        out << "],";
+        out << "\"error\":";
+        write_number(out, fit.error[function_num]);
+        out << "}";
+        if(function_num < num_functions - 1) out << ",";
+    }
+    out << "},";
+
+    // Write data (the rows of the ratio that the converging fit uses, where it is finite):
+    out << "\"data\":{";
+    for(int function_num = 0; function_num < num_functions; ++function_num){ // for each function:
+        const double* ratio = fit.ratios[function_num];
+        out << "\"" << fit.functions[function_num] << "\":{";
+        out << "\"x\":[";
+        for(int i = 0, written = 0; i < fit.rows; ++i){
+            if(isnan(ratio[i]) || isinf(ratio[i])) continue;
+            out << (written++ > 0 ? "," : "") << (int) fit.n[i];
+        }
+        out << "],";
+        out << "\"y\":[";
+        for(int i = 0, written = 0; i < fit.rows; ++i){
+            if(isnan(ratio[i]) || isinf(ratio[i])) continue;
+            out << (written++ > 0 ? "," : "") << ratio[i];
+        }
+        out << "]}";
+        if(function_num < num_functions - 1) out << ",";
+    }
+    out << "}";
+    out << "}";
+}
@@ -0,0 +1,134 @@
+#ifndef RESULT_FILE
+#define RESULT_FILE
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include "../time_complexity.h"
+
+using namespace std;
+
+// A result file holds every run of one test: a header (RESULT_MAGIC and RESULT_VERSION), then
+// blocks that are only ever appended. Every block starts with a result_block_t, which carries
+// the id of its run, so that runs that append to the same file at once stay apart. A block is
+// appended with a single write, so a reader never sees half of one. The payload of a block is
+// made of 8-byte values (int64_t or double, in the byte order of the writer): fixed fields,
+// strings (their length, then their bytes padded to 8 bytes) and columns (one value per row).
+// Every column starts on an 8-byte boundary, so a reader that maps the file reads them in place.
+#define RESULT_MAGIC "TCRESULT"
+#define RESULT_VERSION 1
+
+typedef enum result_block_kind{
+    RUN_BLOCK = 1, // the start of a run, with its settings (see result_run_t)
+    SAMPLES_BLOCK, // raw samples, the columns of result_samples_t in order
+    RESET_BLOCK,   // the samples of the run before this block were dropped (the test restarted)
+    FIT_BLOCK      // every complexity function fitted against one metric (see result_fit_t). A run
+                   // writes the fit of its cost_metric first, then space, amortized and worst operation
+} result_block_kind_t;
+
+typedef struct result_block{
+    uint32_t kind;
+    uint32_t rows;
+    uint64_t run;
+    uint64_t bytes; // the size of the payload that follows
+} result_block_t;
+
+// A block of raw samples, one row per sample (before the trials of an n are combined). n and
+// iterations are int64_t columns, the rest are doubles (-1 where the field was not measured).
+typedef struct result_samples{
+    int rows;
+    const int64_t* n;
+    const int64_t* iterations;
+    const double* duration;
+    const double* counters[NUM_PERF_COUNTERS];
+    const double* heap_bytes;
+    const double* allocations;
+    const double* rss_bytes;
+    const double* operations;
+    const double* worst_operation;
+    // The sample in the given row.
+    dd_t sample(int row) const;
+} result_samples_t;
+
+// The fit of every complexity function against one metric: the guess of every function (see
+// guess_collection_t), whether it fits, and the ratio table the fit used.
+typedef struct result_fit{
+    string name;      // the name of the test, with a suffix for the fits of other metrics ("-space")
+    int64_t metric;   // cost_metric_t
+    int64_t solver;   // fit_solver_t
+    int64_t st;       // the interval of the test
+    int64_t end;
+    vector<string> functions;
+    const double* a;
+    const double* b;
+    const double* c;
+    const double* d;
+    const double* error;
+    const int64_t* found; // 1 for the functions that fit
+    int rows;
+    const double* n;
+    vector<const double*> ratios; // one column per function, NaN where a row was left out
+} result_fit_t;
+
+// A run: the settings of the test, and the blocks it appended.
+typedef struct result_run{
+    uint64_t id;
+    string name;
+    int64_t created;            // seconds since the epoch
+    int64_t total_budget;       // nanoseconds
+    int64_t computation_budget; // nanoseconds
+    int64_t trials;
+    int64_t calibrate;
+    int64_t cost_metric;
+    int64_t space_metric;
+    int64_t fit_solver;
+    vector<result_samples_t> samples; // the samples after the last reset
+    vector<result_fit_t> fits;
+} result_run_t;
+
+// Appends a run to a result file (creating it when it does not exist). Samples are buffered,
+// and appended as a block of RESULT_BLOCK_ROWS rows at a time, at a reset, before a fit and when
+// the writer is destroyed. The writer may be shared between threads.
+class result_writer{
+private:
+    int fd{-1};
+    uint64_t run;
+    mutex lock;
+    vector<dd_t> pending;
+    void append(uint32_t kind, uint32_t rows, const vector<char>& payload);
+    void flush_samples();
+
+public:
+    result_writer(string path, const result_run_t& settings);
+    ~result_writer();
+    result_writer(const result_writer&) = delete;
+    result_writer& operator=(const result_writer&) = delete;
+    bool usable();
+    void add_sample(const dd_t& sample);
+    void reset();
+    void add_fit(const result_fit_t& fit);
+};
+
+// Maps a result file, and points the runs straight into the mapped file (nothing is copied
+// but the strings). The columns are only valid while the reader exists. A block that was cut
+// off at the end of the file (while it was being appended) is left out.
+class result_reader{
+private:
+    void* map{nullptr};
+    size_t size{0};
+
+public:
+    vector<result_run_t> runs;
+    result_reader(string path);
+    ~result_reader();
+    result_reader(const result_reader&) = delete;
+    result_reader& operator=(const result_reader&) = delete;
+    bool usable();
+};
+
+// Writes the fit as the JSON document that save_to_file writes ({"predictions": ..., "data": ...}).
+void export_json(const result_fit_t& fit, ostream& out);
+
+#endif
@@ -1,11 +1,3 @@
-#include <functional>
-
-auto repeat = [](function<void(int)> f, int n, int times) -> void {
-    for(int i = 0; i < times; ++i){
-        f(n);
-    }
-};
-
 int s(int n){
     long long sum = 0;
     for(int i = 0; i < n; ++i){
@@ -16,17 +8,17 @@ int s(int n){
 
 // ~TC-TEST~ Test #1 O(n)
 void fn(int n){
-    repeat(s, n, 10000);
+    s(n);
 }
 
 // ~TC-TEST~ Test #2 O(1)
 void fn2(int n){
-    repeat(s, 1000, 10000);
+    s(1000);
 }
 
 // ~TC-TEST~ Test #3 O(n^2)
 void fn3(int n){
     for(int i = 0; i < n; ++i){
-        repeat(s, n, 10000);
+        s(n);
     }
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "sample_table.h"
+#include <stdlib.h>
+#include <assert.h>
+
+#define CACHE_LINE 64
+#define NUM_GUESSES 5 // a, b, c, d and the error of a fit
+
+// The bytes of one column of the given type, rounded up to a whole number of cache lines.
+template<typename T> static size_t column_bytes(int rows){
+    size_t bytes = rows * sizeof(T);
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+sample_table::~sample_table(){
+    free(arena);
+}
+
+void sample_table::reserve(int rows, int num_functions){
+    this->num_functions = num_functions;
+    if(rows <= capacity && num_functions <= function_capacity){
+        reset();
+        return;
+    }
+
+    if(rows < capacity) rows = capacity;
+    if(num_functions < function_capacity) num_functions = function_capacity;
+    size_t long_column = column_bytes<long double>(rows);
+    size_t double_column = column_bytes<double>(rows);
+    size_t guess_column = column_bytes<double>(num_functions);
+    size_t bytes = double_column + 5 * long_column + num_functions * (long_column + 2 * double_column)
+        + NUM_GUESSES * guess_column + column_bytes<int64_t>(num_functions);
+
+    free(arena);
+    void* block = nullptr;
+    int rv = posix_memalign(&block, CACHE_LINE, bytes);
+    assert(rv == 0);
+    arena = (char*) block;
+    capacity = rows;
+    function_capacity = num_functions;
+
+    char* column = arena;
+    n_column = (double*) column;                      column += double_column;
+    cost_column = (long double*) column;              column += long_column;
+    variance_column = (long double*) column;          column += long_column;
+    cost_weight_column = (long double*) column;       column += long_column;
+    log_n_column = (long double*) column;             column += long_column;
+    log_cost_column = (long double*) column;          column += long_column;
+    basis_columns = (long double*) column;            column += num_functions * long_column;
+    ratio_columns = (double*) column;                 column += num_functions * double_column;
+    ratio_weight_columns = (double*) column;          column += num_functions * double_column;
+    guess_columns = (double*) column;                 column += NUM_GUESSES * guess_column;
+    found_column = (int64_t*) column;
+    reset();
+}
+
+void sample_table::reset(){
+    rows = 0;
+    firsts.assign(num_functions, 0);
+    lasts.assign(num_functions, -1);
+}
+
+void sample_table::resize(int rows){
+    assert(rows <= capacity);
+    this->rows = rows;
+}
+
+int sample_table::size() const{
+    return rows;
+}
+
+int sample_table::functions() const{
+    return num_functions;
+}
+
+double* sample_table::n() const{
+    return n_column;
+}
+
+long double* sample_table::cost() const{
+    return cost_column;
+}
+
+long double* sample_table::variance() const{
+    return variance_column;
+}
+
+long double* sample_table::cost_weight() const{
+    return cost_weight_column;
+}
+
+long double* sample_table::log_n() const{
+    return log_n_column;
+}
+
+long double* sample_table::log_cost() const{
+    return log_cost_column;
+}
+
+long double* sample_table::basis(int function) const{
+    return basis_columns + function * (column_bytes<long double>(capacity) / sizeof(long double));
+}
+
+double* sample_table::ratio(int function) const{
+    return ratio_columns + function * (column_bytes<double>(capacity) / sizeof(double));
+}
+
+double* sample_table::ratio_weight(int function) const{
+    return ratio_weight_columns + function * (column_bytes<double>(capacity) / sizeof(double));
+}
+
+double* sample_table::guess(int parameter) const{
+    return guess_columns + parameter * (column_bytes<double>(function_capacity) / sizeof(double));
+}
+
+int64_t* sample_table::found() const{
+    return found_column;
+}
+
+int& sample_table::first(int function){
+    return firsts[function];
+}
+
+int& sample_table::last(int function){
+    return lasts[function];
+}
@@ -0,0 +1,68 @@
+#ifndef SAMPLE_TABLE
+#define SAMPLE_TABLE
+
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+// The samples of one fit, stored by column: every column is a contiguous array with one
+// entry per row (one row per n, in n order), and the columns of every complexity function
+// are laid out one after another. All of the columns live in one block of memory that is
+// only allocated when the table has to grow, so clearing and refilling the table for the
+// next test allocates nothing. Columns start on cache lines, so the fits (and the batched
+// kernels of gradient_descent) can read them in place. The fit of every function is stored
+// along with the samples, so the result file and the JSON export read it in place as well.
+class sample_table{
+private:
+    char* arena{nullptr};
+    int capacity{0};
+    int function_capacity{0};
+    int num_functions{0};
+    int rows{0};
+    vector<int> firsts;
+    vector<int> lasts;
+    double* n_column;
+    long double* cost_column;
+    long double* variance_column;
+    long double* cost_weight_column;
+    long double* log_n_column;
+    long double* log_cost_column;
+    long double* basis_columns;
+    double* ratio_columns;
+    double* ratio_weight_columns;
+    double* guess_columns;
+    int64_t* found_column;
+
+public:
+    sample_table() = default;
+    sample_table(const sample_table&) = delete;
+    sample_table& operator=(const sample_table&) = delete;
+    ~sample_table();
+    // Makes room for at least this many rows of this many functions, and empties the table.
+    // The memory only grows, so a smaller table after a larger one allocates nothing.
+    void reserve(int rows, int num_functions);
+    // Empties the table, and keeps its memory.
+    void reset();
+    // Sets the number of rows (at most the reserved number).
+    void resize(int rows);
+    int size() const;
+    int functions() const;
+
+    double* n() const;                 // the n of every row
+    long double* cost() const;         // the cost per call that is fitted
+    long double* variance() const;     // the variance of the cost over the trials
+    long double* cost_weight() const;  // the weight of the cost in the closed-form fit
+    long double* log_n() const;
+    long double* log_cost() const;     // NaN where the cost is not positive
+    long double* basis(int function) const;        // f(n)
+    double* ratio(int function) const;              // the normalized cost / f(n), NaN where it is not finite
+    double* ratio_weight(int function) const;      // the weight of the ratio in the converging fit
+    double* guess(int parameter) const;             // a parameter of the fit of every function (a, b, c, d, then the error, see guess_collection_t)
+    int64_t* found() const;                         // 1 for every function that fits, 0 otherwise
+    // The rows that the converging fit of the function uses are [first, last], 0 rows when first > last.
+    int& first(int function);
+    int& last(int function);
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "supervisor.h"
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+
+#define get_time duration_cast<nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count()
+#define TIMER_KEY ((uint64_t) 1 << 32)
+#define MAX_EVENTS 64
+#define MIN_SLEEP 20000    // first nap (ns) of the fallback loop for children without a pidfd
+#define MAX_SLEEP 1000000  // longest nap (ns) of the fallback loop
+
+#if defined(__linux__) && !defined(SYS_pidfd_open)
+#define SYS_pidfd_open 434
+#endif
+
+// ----------- PRIVATE -----------
+// checks whether the child has exited, without reaping it.
+bool supervisor::child_exited(pid_t pid){
+    siginfo_t info;
+    info.si_pid = 0;
+    if(waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1) return true; // not our child (anymore).
+    return info.si_pid != 0;
+}
+
+vector<int> supervisor::wait_with_epoll(long long timeout){
+    vector<int> ready;
+#ifdef __linux__
+    struct epoll_event events[MAX_EVENTS];
+    struct itimerspec its = {};
+    its.it_value.tv_sec = timeout / 1000000000;
+    its.it_value.tv_nsec = timeout % 1000000000;
+    if(timeout > 0) timerfd_settime(timer_fd, 0, &its, nullptr);
+
+    bool timed_out = false;
+    while(ready.empty() && !timed_out){
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout > 0 ? -1 : 0);
+        if(count < 0 && errno == EINTR) continue;
+        if(count <= 0) break;
+
+        for(int i = 0; i < count; ++i){
+            if(events[i].data.u64 == TIMER_KEY) timed_out = true;
+            else ready.push_back((int) (uint32_t) events[i].data.u64);
+        }
+    }
+
+    // disarm the timer and clear an expiration we did not consume.
+    its = {};
+    timerfd_settime(timer_fd, 0, &its, nullptr);
+    uint64_t expirations;
+    while(read(timer_fd, &expirations, sizeof(uint64_t)) > 0);
+#endif
+    return ready;
+}
+
+vector<int> supervisor::wait_with_poll(long long timeout){
+    vector<int> ready;
+    vector<struct pollfd> pfds;
+    vector<int> pfd_ids;
+    bool has_children_without_fd = false;
+
+    for(int i = 0; i < items.size(); ++i){
+        if(items[i].fd == -1){
+            has_children_without_fd = true;
+        }else{
+            pfds.push_back({items[i].fd, POLLIN, 0});
+            pfd_ids.push_back(items[i].id);
+        }
+    }
+
+    long long start_time = get_time;
+    long long nap = MIN_SLEEP;
+    while(true){
+        long long remaining = timeout - (get_time - start_time);
+
+        // we can only block in poll() when no child has to be checked by hand.
+        int poll_timeout = (has_children_without_fd || remaining <= 0) ? 0 : (int) ((remaining + 999999) / 1000000);
+        if(poll(pfds.data(), pfds.size(), poll_timeout) > 0){
+            for(int i = 0; i < pfds.size(); ++i){
+                if(pfds[i].revents != 0) ready.push_back(pfd_ids[i]);
+            }
+        }
+
+        for(int i = 0; i < items.size(); ++i){
+            if(items[i].fd == -1 && child_exited(items[i].pid)) ready.push_back(items[i].id);
+        }
+
+        remaining = timeout - (get_time - start_time);
+        if(!ready.empty() || remaining <= 0) break;
+
+        if(has_children_without_fd){
+            struct timespec ts = {0, (long) (nap < remaining ? nap : remaining)};
+            nanosleep(&ts, nullptr);
+            nap = nap * 2 < MAX_SLEEP ? nap * 2 : MAX_SLEEP;
+        }
+    }
+
+    return ready;
+}
+
+// ----------- PUBLIC -----------
+supervisor::supervisor(){
+    epoll_fd = -1;
+    timer_fd = -1;
+#ifdef __linux__
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = TIMER_KEY;
+    if(epoll_fd < 0 || timer_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1){
+        if(epoll_fd >= 0) close(epoll_fd);
+        if(timer_fd >= 0) close(timer_fd);
+        epoll_fd = -1;
+        timer_fd = -1;
+    }
+#endif
+}
+
+supervisor::~supervisor(){
+    while(!items.empty()){
+        unwatch(items.back().id);
+    }
+    if(epoll_fd >= 0) close(epoll_fd);
+    if(timer_fd >= 0) close(timer_fd);
+}
+
+// Wakes wait() once the child exits. The child is not reaped.
+void supervisor::watch_child(int id, pid_t pid){
+#ifdef __linux__
+    int pidfd = (int) syscall(SYS_pidfd_open, pid, 0);
+    if(pidfd >= 0){
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = (uint32_t) id;
+        if(epoll_fd >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pidfd, &ev);
+        items.push_back({id, pid, pidfd, true});
+        return;
+    }
+#endif
+    items.push_back({id, pid, -1, false});
+}
+
+// Wakes wait() once fd becomes readable or hangs up. The caller keeps ownership of fd.
+void supervisor::watch_fd(int id, int fd){
+#ifdef __linux__
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = (uint32_t) id;
+    if(epoll_fd >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+#endif
+    items.push_back({id, -1, fd, false});
+}
+
+void supervisor::unwatch(int id){
+    for(int i = 0; i < items.size(); ++i){
+        if(items[i].id != id) continue;
+#ifdef __linux__
+        if(epoll_fd >= 0 && items[i].fd >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, items[i].fd, nullptr);
+#endif
+        if(items[i].owns_fd) close(items[i].fd);
+        items.erase(items.begin() + i);
+        return;
+    }
+}
+
+// Sleeps for at most timeout nanoseconds. Returns the ids of everything that is ready,
+// or an empty vector if the timeout passed first.
+vector<int> supervisor::wait(long long timeout){
+    if(timeout < 0) timeout = 0;
+
+    bool can_use_epoll = epoll_fd >= 0;
+    for(int i = 0; i < items.size(); ++i){
+        if(items[i].fd == -1) can_use_epoll = false;
+    }
+
+    return can_use_epoll ? wait_with_epoll(timeout) : wait_with_poll(timeout);
+}
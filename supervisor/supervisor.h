@@ -0,0 +1,41 @@
+#ifndef SUPERVISOR
+#define SUPERVISOR
+
+#include <vector>
+#include <sys/types.h>
+
+using namespace std;
+
+typedef struct watched{
+    int id;    // the caller's name for this child or file descriptor.
+    pid_t pid; // the child we wait on, -1 if we wait on a file descriptor.
+    int fd;    // what we sleep on (a pidfd for children), -1 if there is none.
+    bool owns_fd;
+} watched_t;
+
+// Sleeps until a watched child exits, a watched file descriptor becomes readable
+// (or hangs up) or a deadline passes, instead of spinning on waitpid(..., WNOHANG).
+// On Linux this is epoll over pidfds and a timerfd. Elsewhere (or on kernels without
+// pidfd_open) it falls back to poll() and a sleeping waitid() loop.
+// Children are never reaped here, the caller still calls waitpid on them.
+class supervisor{
+private:
+    int epoll_fd;
+    int timer_fd;
+    vector<watched_t> items;
+    bool child_exited(pid_t pid);
+    vector<int> wait_with_epoll(long long timeout);
+    vector<int> wait_with_poll(long long timeout);
+
+public:
+    supervisor();
+    supervisor(const supervisor&) = delete;
+    supervisor& operator=(const supervisor&) = delete;
+    ~supervisor();
+    void watch_child(int id, pid_t pid);
+    void watch_fd(int id, int fd);
+    void unwatch(int id);
+    vector<int> wait(long long timeout);
+};
+
+#endif
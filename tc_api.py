@@ -1,14 +1,346 @@
-from flask import Flask, request
+from flask import Flask, request, send_file
 import os
 import sys
 import subprocess
+import hashlib
+import json
+import platform
+import shutil
+import time
+import uuid
+import queue
+import threading
 
 app = Flask(__name__)
 
-SAVE_DIR = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/cpp-file-cache"
 DATA_DIR = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/data"
-OUTPUT_PATH = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/output/output.txt"
-BASH_FILE = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/test_input"
+TC_PATH = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester"
+CACHE_DIR = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/result-cache"
+JOBS_DIR = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/jobs"
+LOAD_PROGRAM = "/Users/Siddhant/Desktop/Github/Time-Complexity-Tester/python-scripts/load_program.py"
+# How long a finished job can still be polled, in seconds.
+JOB_RETENTION = 60 * 60
+
+# Files whose content changes what a test compiles to (or how it is measured): the
+# build scripts, and every source of the tester library (see tester_files). A change
+# to any of them invalidates every cached result.
+BUILD_FILES = ["Makefile", "test_input", "python-scripts/load_program.py",
+    "precompiled/common.h"]
+
+# The build scripts, and every file of the tester library: the sources in FILES of the
+# Makefile and the slim wrapper, each with every header and source in its directory.
+def tester_files():
+    sources = ["time_complexity_slim.cpp"]
+    with open(TC_PATH + "/Makefile", "r") as f:
+        for line in f:
+            if line.startswith("FILES="): sources += line[len("FILES="):].split()
+
+    files = list(BUILD_FILES)
+    for source in sources:
+        stem : str = os.path.splitext(source)[0]
+        if os.path.isdir(TC_PATH + "/" + stem): # a module: every file in its directory
+            files += sorted(stem + "/" + name for name in os.listdir(TC_PATH + "/" + stem)
+                if name.endswith(".h") or name.endswith(".cpp"))
+        else: # a source next to the Makefile, and its header
+            files += [name for name in [stem + ".cpp", stem + ".h"]
+                if os.path.exists(TC_PATH + "/" + name)]
+    return files
+
+# Describes the machine that measures, so that results from another cpu (or a
+# copied cache directory) are never returned.
+def machine_fingerprint() -> str:
+    uname = platform.uname()
+    cpu : str = platform.processor()
+    try:
+        with open("/proc/cpuinfo", "r") as f:
+            models = [line for line in f if line.startswith("model name")]
+            if len(models) > 0: cpu = models[0].split(":", 1)[1].strip()
+    except OSError:
+        proc = subprocess.run(["sysctl", "-n", "machdep.cpu.brand_string"],
+            capture_output=True)
+        if proc.returncode == 0: cpu = proc.stdout.decode('utf8').strip()
+    return "|".join([uname.system, uname.node, uname.release, uname.machine,
+        cpu, str(os.cpu_count())])
+
+# Describes the compiler and its flags: the compiler version, and every file that
+# decides how a test is generated, built and measured.
+def compiler_fingerprint() -> str:
+    proc = subprocess.run(["g++", "--version"], capture_output=True)
+    digest = hashlib.sha256(proc.stdout)
+    for name in tester_files():
+        path : str = TC_PATH + "/" + name
+        if os.path.exists(path):
+            with open(path, "rb") as f:
+                digest.update(name.encode('utf8') + b"\0" + f.read())
+    return digest.hexdigest()
+
+# Computed once: neither changes while the service runs (restart it after
+# rebuilding the tester).
+MACHINE = machine_fingerprint()
+COMPILER = compiler_fingerprint()
+
+# The key of a result: the program, the budget, the compiler and the machine. The
+# name of a submission only names its file, so it is left out.
+def cache_key(code : str, budget : int) -> str:
+    key = json.dumps({"code": code, "budget": budget, "compiler": COMPILER,
+        "machine": MACHINE}, sort_keys=True)
+    return hashlib.sha256(key.encode('utf8')).hexdigest()
+
+# Returns the stored result of a key, or None if there is none.
+def cache_lookup(key : str):
+    path : str = CACHE_DIR + "/" + key + "/result.json"
+    if not os.path.exists(path):
+        return None
+    with open(path, "r") as f:
+        return json.load(f)
+
+# Stores the verdict of a run along with the data files it saved (files maps the
+# path of a file in the data directory to where the run saved it). The entry is
+# written to a temporary directory first and renamed into place, so a concurrent
+# lookup never sees half of it.
+def cache_store(key : str, name : str, budget : int, output : str, files):
+    entry : str = CACHE_DIR + "/" + key
+    staging : str = entry + ".tmp-" + str(os.getpid()) + "-" + str(time.time_ns())
+    os.makedirs(staging + "/data")
+    for path, source in files.items():
+        target : str = staging + "/data/" + path
+        os.makedirs(os.path.dirname(target), exist_ok=True)
+        shutil.copy2(source, target)
+
+    result = {"name": name, "budget": budget, "message": output,
+        "data": sorted(files), "created": time.time()}
+    with open(staging + "/result.json", "w") as f:
+        json.dump(result, f)
+
+    if os.path.exists(entry):
+        shutil.rmtree(entry, ignore_errors=True) # refreshed
+    try:
+        os.rename(staging, entry)
+    except OSError: # another run of the same program stored it first
+        shutil.rmtree(staging, ignore_errors=True)
+
+# The cores that measure. Measurements run on the cores the kernel isolated from
+# the scheduler (isolcpus=...), one measurement per core, unless TC_MEASURE_CPUS
+# lists them (for example "2,3" or "4-7"). Without either, one measurement runs
+# at a time, on any core.
+def measure_cpus():
+    cpus : str = os.environ.get("TC_MEASURE_CPUS", "")
+    if len(cpus) == 0 and os.path.exists("/sys/devices/system/cpu/isolated"):
+        with open("/sys/devices/system/cpu/isolated", "r") as f:
+            cpus = f.read().strip()
+    result = []
+    for part in filter(None, cpus.split(",")):
+        first, _, last = part.partition("-")
+        result += range(int(first), int(last or first) + 1)
+    return result if len(result) > 0 else [None]
+
+MEASURE_CPUS = measure_cpus()
+
+# Lets either compiles or measurements run, never both at once, so a compile never
+# competes with a measurement for the caches and the memory bus. Up to limit jobs
+# of the running phase run together. Once the other phase waits, no new job of the
+# running phase is let in, so neither phase starves.
+class PhaseGate:
+    def __init__(self, limit : int):
+        self.limit = limit
+        self.phase = None
+        self.running = 0
+        self.waiting = {"compile": 0, "measure": 0}
+        self.changed = threading.Condition()
+
+    def enter(self, phase : str):
+        other : str = "measure" if phase == "compile" else "compile"
+        with self.changed:
+            self.waiting[phase] += 1
+            while not (self.phase is None or (self.phase == phase
+                    and self.running < self.limit and self.waiting[other] == 0)):
+                self.changed.wait()
+            self.waiting[phase] -= 1
+            self.phase = phase
+            self.running += 1
+
+    def leave(self):
+        with self.changed:
+            self.running -= 1
+            if self.running == 0: self.phase = None
+            self.changed.notify_all()
+
+# A submitted program. Its state goes from "queued" to "compiling" and "measuring",
+# and ends in "done" or "failed". Everything the job writes stays in its own
+# directory, JOBS_DIR/<id>: the test (main.cpp, test.exe), the output of the
+# tester (output.txt) and the data it saved (data/). The directory is removed
+# once the job finishes (its data is published and cached by then), and the job
+# itself JOB_RETENTION seconds later. The data of a job is the paths of its files
+# in DATA_DIR, which are also the paths of the files in its cache entry.
+class Job:
+    def __init__(self, name : str, budget : int, code : str, key : str):
+        self.id : str = uuid.uuid4().hex
+        self.name = name
+        self.budget = budget
+        self.code = code
+        self.key = key
+        self.dir : str = JOBS_DIR + "/" + self.id
+        self.state : str = "queued"
+        self.message : str = ""
+        self.data = []
+        self.cached : bool = False
+        self.created : float = time.time()
+        self.finished_at : float = 0
+        self.finished = threading.Event()
+
+    def finish(self, state : str, message : str):
+        self.state = state
+        self.message = message
+        self.finished_at = time.time()
+        self.finished.set()
+
+    # The response for the job. While the job measures, the message is the
+    # output of the tester so far.
+    def status(self):
+        message : str = self.message
+        if self.state == "measuring":
+            try:
+                with open(self.dir + "/output.txt", "r") as f:
+                    message = f.read()
+            except OSError: # not started yet, or finished and removed
+                pass
+        status : str = {"done": "SUCCESS", "failed": "ERROR"}.get(self.state, "PENDING")
+        return {"status": status, "job": self.id, "state": self.state,
+            "message": message, "cached": self.cached, "key": self.key,
+            "data": self.data, "created": self.created}
+
+jobs = {}
+jobs_lock = threading.Lock()
+job_queue = queue.Queue()
+gate = PhaseGate(len(MEASURE_CPUS))
+publish_lock = threading.Lock()
+
+# Copies the data a job saved (paths in its data directory) into the shared data
+# directory: JSON files are copied (renamed if a file of the same name exists),
+# and the runs of a result file are appended to the result file of the test
+# (without the header). Returns where every file went (its path in DATA_DIR) and
+# the file of the job it came from.
+def publish_data(job : Job, saved):
+    published = {}
+    with publish_lock:
+        for path in saved:
+            source : str = job.dir + "/data/" + path
+            target : str = path
+            os.makedirs(os.path.dirname(DATA_DIR + "/" + target), exist_ok=True)
+            if path.endswith(".tcr") and os.path.exists(DATA_DIR + "/" + target):
+                with open(source, "rb") as f:
+                    runs : bytes = f.read()[16:]
+                with open(DATA_DIR + "/" + target, "ab") as f:
+                    f.write(runs)
+            else:
+                if os.path.exists(DATA_DIR + "/" + target):
+                    root, extension = os.path.splitext(target)
+                    target = root + "-" + job.id[:8] + extension
+                shutil.copy2(source, DATA_DIR + "/" + target)
+            published[target] = source
+    return published
+
+# Generates and compiles the test of a job, then measures it on the given core.
+def run_job(job : Job, cpu):
+    os.makedirs(job.dir)
+    job.state = "compiling"
+    gate.enter("compile")
+    try:
+        proc = subprocess.run(["python3", LOAD_PROGRAM, "--slim", "-d", JOBS_DIR, job.id,
+            str(job.budget), job.code], capture_output=True)
+        if proc.returncode == 0:
+            proc = subprocess.run(["make", "-C", TC_PATH, "JOB=" + job.dir, "job"],
+                capture_output=True)
+            if proc.returncode != 0:
+                return job.finish("failed", "Compiler error!\n" + proc.stderr.decode('utf8'))
+        else:
+            return job.finish("failed", proc.stderr.decode('utf8'))
+    finally:
+        gate.leave()
+
+    job.state = "measuring"
+    command = [job.dir + "/test.exe"]
+    if shutil.which("unbuffer") is not None: command = ["unbuffer"] + command
+    if cpu is not None and shutil.which("taskset") is not None:
+        command = ["taskset", "-c", str(cpu)] + command
+    gate.enter("measure")
+    try:
+        with open(job.dir + "/output.txt", "w") as output:
+            proc = subprocess.run(command, cwd=job.dir, stdout=output,
+                stderr=subprocess.PIPE)
+    finally:
+        gate.leave()
+    for file in ["test.o", "test.exe"]:
+        if os.path.exists(job.dir + "/" + file): os.remove(job.dir + "/" + file)
+
+    with open(job.dir + "/output.txt", "r") as f:
+        output : str = f.read()
+    error_str : str = proc.stderr.decode('utf8')
+    if proc.returncode != 0 or len(error_str) > 0:
+        return job.finish("failed", "Runtime error!\n" + error_str)
+
+    saved = []
+    for root, _, files in os.walk(job.dir + "/data"):
+        for file in files:
+            saved.append(os.path.relpath(os.path.join(root, file), job.dir + "/data"))
+    published = publish_data(job, sorted(saved))
+    job.data = sorted(published)
+    cache_store(job.key, job.name, job.budget, output, published)
+    job.finish("done", output)
+
+# One worker per measuring core, each of which carries its jobs through both phases.
+def worker(cpu):
+    while True:
+        job : Job = job_queue.get()
+        try:
+            run_job(job, cpu)
+        except Exception as error:
+            job.finish("failed", "ERROR: " + str(error))
+        finally:
+            shutil.rmtree(job.dir, ignore_errors=True)
+
+# Forgets the jobs that finished more than JOB_RETENTION seconds ago. The caller
+# holds jobs_lock.
+def evict_jobs():
+    expired : float = time.time() - JOB_RETENTION
+    for id in [id for id, job in jobs.items()
+            if job.finished.is_set() and job.finished_at < expired]:
+        del jobs[id]
+
+# Queues a POSTed program, or returns its cached result as a finished job.
+# Returns the job, or an error response.
+def submit(data):
+    if not all(item in data for item in ["name", "budget", "code"]):
+        return None, {"status":"ERROR", 
+            "message": ('POST request must contain '
+                'fields for name, budget, and code')}
+
+    # Variables:
+    name : str = data["name"]
+    budget : int = data["budget"]
+    code : str = data["code"]
+    refresh : bool = data.get("refresh", False)
+
+    # String formatting:
+    code = code.replace("\\n", "\n") # correctly format newline
+
+    # The same program with the same budget was measured before on this
+    # machine, with this compiler: return that result (unless asked to
+    # measure it again).
+    key : str = cache_key(code, budget)
+    job = Job(name, budget, code, key)
+    cached = None if refresh else cache_lookup(key)
+    with jobs_lock:
+        evict_jobs()
+        jobs[job.id] = job
+    if cached is not None:
+        job.cached = True
+        job.data = cached["data"]
+        job.created = cached["created"]
+        job.finish("done", cached["message"])
+    else:
+        job_queue.put(job)
+    return job, None
 
 # If we want to get, it will return all of the logs in the 
 # data directory:
@@ -18,55 +350,62 @@ def data():
     dirs.remove(".DS_Store")
     return {"saved-data":dirs}
 
-# Test some code
+# Test some code, and wait for the result
 @app.route("/test", methods=['POST'])
 def test():
     if not request.is_json:
         return {"status":"ERROR", "message": "ERROR: Post type must be JSON."}
-    else:
-        data = request.get_json()
-        if not all(item in data for item in ["name", "budget", "code"]):
-            return {"status":"ERROR", 
-            "message": ('POST request must contain '
-                'fields for name, budget, and code')}
-        else:
-            # Variables:
-            name : str = data["name"]
-            budget : int = data["budget"]
-            code : str = data["code"]
-            fpath : str = SAVE_DIR + "/" + name + ".cpp"
-
-            # String formatting:
-            code = code.replace("\\n", "\n") # correctly format newline
-
-            # Create the file if it does not exist
-            if not os.path.exists(SAVE_DIR):
-                os.mkdir(SAVE_DIR)
-
-            if not os.path.exists(fpath):
-                open(fpath, "x")
-            
-            # Write the given input into the file:
-            f = open(fpath, "w")
-            f.write(code)
-            f.close()
-
-            proc = subprocess.run([BASH_FILE, name, str(budget), fpath],
-                capture_output=True)
-            
-            out_str : str = proc.stdout.decode('utf8')
-            error_str : str = proc.stderr.decode('utf8')
-            print("STD Out: ", out_str)
-            print("STD Error: ", error_str)
+    job, error = submit(request.get_json())
+    if error is not None:
+        return error
+    job.finished.wait()
+    result = job.status()
+    print("Job", job.id, job.state, "\n", result["message"])
+    return result
 
-            if proc.returncode != 0 or len(error_str) > 0:
-                return {"status":"ERROR", "message":error_str} 
+# Queue some code, and return its job at once (poll it with GET /jobs/<job>)
+@app.route("/jobs", methods=['POST'])
+def submit_job():
+    if not request.is_json:
+        return {"status":"ERROR", "message": "ERROR: Post type must be JSON."}
+    job, error = submit(request.get_json())
+    if error is not None:
+        return error
+    return job.status(), 202
 
-            f = open(OUTPUT_PATH, "r")
-            output : str = f.read()
+# Returns the state (and the output so far) of a job
+@app.route("/jobs/<id>", methods=['GET'])
+def job_status(id):
+    with jobs_lock:
+        job = jobs.get(id)
+    if job is None:
+        return {"status":"ERROR", "message": "ERROR: No such job."}, 404
+    return job.status()
 
-            return {"status":"SUCCESS", "message": output}
+# Lists every job with its state
+@app.route("/jobs", methods=['GET'])
+def list_jobs():
+    with jobs_lock:
+        evict_jobs()
+        listed = [{"job": job.id, "name": job.name, "state": job.state,
+            "created": job.created} for job in jobs.values()]
+    return {"jobs": listed, "measure-cpus": MEASURE_CPUS,
+        "queued": job_queue.qsize()}
 
+# Returns a data file stored with a cached result.
+@app.route("/cache/<key>/<path:file>", methods=['GET'])
+def cached_data(key, file):
+    entry : str = os.path.realpath(CACHE_DIR + "/" + key + "/data")
+    path : str = os.path.realpath(entry + "/" + file)
+    if not path.startswith(entry + os.sep) or not os.path.isfile(path):
+        return {"status":"ERROR", "message": "ERROR: No such cached file."}, 404
+    return send_file(path)
 
 
-app.run()
\ No newline at end of file
+if __name__ == "__main__":
+    # Build the tester library and the precompiled header once, so that the compiles
+    # of jobs only build their tests.
+    subprocess.run(["make", "-C", TC_PATH, "library"])
+    for cpu in MEASURE_CPUS:
+        threading.Thread(target=worker, args=(cpu,), daemon=True).start()
+    app.run(threaded=True)
@@ -0,0 +1,44 @@
+#include "../../time_complexity.h"
+#include <functional>
+#include <stdlib.h>
+
+// --------------------------- TESTING FUNCTIONS ---------------------------
+// Clearly quadratic: every pair of the n elements.
+void all_pairs(int n);
+// Its cost is noise that does not depend on n, so no function ever explains it with confidence.
+void noise(int n);
+
+volatile long long sink;
+
+int main(void){
+    int budget = 3000;
+    time_complexity tc(budget, 200);
+    tc.early_stop = true;
+    tc.save_data = false;
+    bool ok = true;
+
+    // a clear-cut function stops sampling early, with the same verdict.
+    ok = tc.compute_complexity("All pairs", all_pairs, "T(n^2)") && ok;
+    printf("All pairs left %lldms of the budget unused\n", tc.get_unused_budget());
+    ok = tc.get_unused_budget() > 0 && ok;
+
+    // an ambiguous one uses the whole budget.
+    tc.compute_complexity("Noise", noise);
+    printf("Noise left %lldms of the budget unused\n", tc.get_unused_budget());
+    ok = tc.get_unused_budget() == 0 && ok;
+
+    return ok ? 0 : 1;
+}
+
+void all_pairs(int n){
+    for(int i = 0; i < n; ++i){
+        for(int j = 0; j < n; ++j) sink += i ^ j;
+    }
+}
+
+void noise(int n){
+    // seeded with n: the amount is the same for every call with n, but unrelated to n.
+    srand(n * 2654435761u);
+    int amount = rand() % 1000000;
+    for(int i = 0; i < amount; ++i) sink += i;
+}
@@ -0,0 +1,30 @@
+#include "../../time_complexity.h"
+#include <functional>
+#include <math.h>
+
+// --------------------------- TESTING FUNCTIONS ---------------------------
+// n^1.5 steps, which none of the default functions is.
+void n_root_n(int n);
+
+volatile long long sink;
+
+int main(void){
+    time_complexity tc(5000, 20);
+    tc.save_data = false;
+    bool ok = true;
+
+    // only a family can name the verdict: with the default functions alone it cannot be Θ(n^1.5).
+    tc.show_possible_big_o = false;
+    ok = !tc.compute_complexity("n sqrt(n), default functions", n_root_n, "T(n^1.5)") && ok;
+
+    tc.show_possible_big_o = true;
+    tc.families = parametric_families();
+    ok = tc.compute_complexity("n sqrt(n), parametric families", n_root_n, "T(n^1.5)") && ok;
+
+    return ok ? 0 : 1;
+}
+
+void n_root_n(int n){
+    long long steps = (long long) (n * sqrt(n));
+    for(long long k = 0; k < steps; ++k) sink += k;
+}
@@ -1,6 +1,7 @@
 #include <math.h>
 #include <cassert>
 #include <sstream>
+#include <cstring>
 #include <stdlib.h>
 #include <chrono>
 #include <thread>
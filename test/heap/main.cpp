@@ -21,16 +21,10 @@ void test(function<bool(int, int)> comp, int);
 bool omega_test(function<void(int)>, vector<function_type_t>, int, int, int);
 void test_push_back_worst_case(int n);
 void test_push_back_best_case(int n);
+void test_push_back_per_operation(int n);
 void test_constantc(int n);
 void test_linearc(int n);
 
-// repeats fn a times.
-auto repeat = [](function<void(int)> fn, int a) -> function<void(int)> {
-    return [a, &fn](int n) -> void {
-        for(int i = 0; i < a; ++i) fn(n);
-    };
-};
-
 // class T must override the < and > operators in order for min_heap to work.
 template<class T> class heap{
     private:
@@ -149,12 +143,17 @@ int main(void){
 
 
     time_complexity tc(10000, 100);
+    tc.calibrate = true; // repeats short calls until every sample is measurable
     cout << "Convergence error = 0.01 (default), tc(10000, 100)\n";
     tc.compute_complexity("Unknown test function", test_func, "O(n log n)");
     tc.compute_complexity("vector.push_back(rand)", test_linearc, "O(n)");
-    tc.compute_complexity("heap.push_back(decreasing)", repeat(test_push_back_worst_case, 1000), "O(1)"); // should be log n, but it generally performs better than log n
+    tc.compute_complexity("heap.push_back(decreasing)", test_push_back_worst_case, "O(1)"); // should be log n, but it generally performs better than log n
     tc.compute_complexity("heap.push_back(increasing)", test_push_back_best_case);
     tc.compute_complexity("Constant # of heap.push_back", test_constantc, "O(n)");
+
+    // the amortized and the worst push, rather than the total time of n pushes.
+    tc.per_operation = true;
+    tc.compute_complexity("heap.push_back(decreasing) per push", test_push_back_per_operation, "O(n log n)");
 }
 
 void test_linearc(int n){
@@ -190,6 +189,16 @@ void test_push_back_best_case(int n){
     }
 }
 
+void test_push_back_per_operation(int n){
+    function<bool(int,int)> comp = [](int x, int y) -> bool {return x < y;};
+    heap<int> mh(comp, 500000);
+
+    for(int i = 0; i < n; ++i){
+        mh.push(n - i);
+        operation_done();
+    }
+}
+
 void test_constantc(int n){
     function<bool(int,int)> comp = [](int x, int y) -> bool {return x > y;};
     heap<int> mh(comp, n);
@@ -0,0 +1,36 @@
+#include "../../time_complexity.h"
+#include <functional>
+#include <vector>
+
+// --------------------------- TESTING FUNCTIONS ---------------------------
+// Touches every cell of an n x m table.
+void fill_table(int n, int m);
+// Scans two arrays, one of each length (given as x = {n, m}).
+void scan_both(const vector<int>& x);
+
+volatile long long sink;
+
+int main(void){
+    time_complexity tc(10000, 200);
+    bool ok = true;
+
+    // the product of the variables: every n meets every m.
+    ok = tc.compute_complexity("Table fill", fill_table, "T(n m)") && ok;
+
+    // the sum of the variables, through the overload that takes any number of them.
+    ok = tc.compute_complexity("Two scans", scan_both, {"n", "m"}, "T(n + m)") && ok;
+
+    return ok ? 0 : 1;
+}
+
+void fill_table(int n, int m){
+    for(int i = 0; i < n; ++i){
+        for(int j = 0; j < m; ++j) sink += i ^ j;
+    }
+}
+
+void scan_both(const vector<int>& x){
+    for(int k = 0; k < 2; ++k){
+        for(int i = 0; i < x[k]; ++i) sink += i;
+    }
+}
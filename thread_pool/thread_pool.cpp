@@ -0,0 +1,53 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+// ----------- PRIVATE -----------
+// Takes the next iteration of the job and runs it without holding the lock.
+void thread_pool::run_one(job_t* job, unique_lock<mutex>& guard){
+    int i = job->next++;
+    if(job->next == job->count) jobs.erase(find(jobs.begin(), jobs.end(), job));
+
+    guard.unlock();
+    job->task(i);
+    guard.lock();
+
+    if(++job->finished == job->count) work_finished.notify_all();
+}
+
+void thread_pool::worker_loop(){
+    unique_lock<mutex> guard(lock);
+    while(true){
+        work_available.wait(guard, [this]() -> bool {return stopping || !jobs.empty();});
+        if(jobs.empty()) return; // stopping, and nothing is left to do.
+        run_one(jobs.front(), guard);
+    }
+}
+
+// ----------- PUBLIC -----------
+thread_pool::thread_pool(int size){
+    for(int i = 1; i < size; ++i){
+        threads.push_back(thread(&thread_pool::worker_loop, this));
+    }
+}
+
+thread_pool::~thread_pool(){
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for(int i = 0; i < threads.size(); ++i) threads[i].join();
+}
+
+void thread_pool::for_each(int count, function<void(int)> task){
+    if(count <= 0) return;
+
+    job_t job = {task, count, 0, 0};
+    unique_lock<mutex> guard(lock);
+    jobs.push_back(&job);
+    work_available.notify_all();
+
+    // help out with our own job, then wait for the iterations that other threads took.
+    while(job.next < job.count) run_one(&job, guard);
+    work_finished.wait(guard, [&job]() -> bool {return job.finished == job.count;});
+}
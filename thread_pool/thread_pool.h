@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// A fixed set of threads that run the iterations of for_each concurrently. The thread that
+// calls for_each runs iterations as well, so a pool of size 1 has no threads of its own, and
+// for_each may be called from inside of an iteration (the inner loop never waits on
+// threads that are busy with the outer one).
+class thread_pool{
+private:
+    typedef struct job{
+        function<void(int)> task;
+        int count;
+        int next;     // the next iteration to hand out
+        int finished; // how many iterations have returned
+    } job_t;
+
+    vector<thread> threads;
+    deque<job_t*> jobs; // jobs with iterations left to hand out
+    mutex lock;
+    condition_variable work_available;
+    condition_variable work_finished;
+    bool stopping{false};
+    void worker_loop();
+    void run_one(job_t* job, unique_lock<mutex>& guard);
+
+public:
+    thread_pool(int size);
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+    ~thread_pool();
+    // Calls task(i) for 0 <= i < count, and returns once every call has returned.
+    void for_each(int count, function<void(int)> task);
+};
+
+#endif
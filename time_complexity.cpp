@@ -1,5 +1,13 @@
 #include "time_complexity.h"
 #include "./gradient_descent/gradient_descent.h"
+#include "./worker_pool/worker_pool.h"
+#include "./in_process/in_process.h"
+#include "./perf_counters/perf_counters.h"
+#include "./least_squares/least_squares.h"
+#include "./levenberg_marquardt/levenberg_marquardt.h"
+#include "./thread_pool/thread_pool.h"
+#include "./operation_timer/operation_timer.h"
+#include "./result_file/result_file.h"
 #include <sys/stat.h>
 #include <iostream>
 #include <iomanip>
@@ -15,15 +23,51 @@
 #include <time.h>
 #include <cmath>
 #include <signal.h>
+#include <cassert>
+#include <climits>
+#include <sys/wait.h>
 #include <tuple>
+#include <fcntl.h>
+#include <algorithm>
+#include <set>
+#include <memory>
+#include <sched.h>
+#include <thread>
 #define get_time duration_cast<nanoseconds>(chrono::high_resolution_clock::now().time_since_epoch()).count()
 
 #define MIN_TABLE_VALUES 3
 #define DATA_BEFORE_DOUBLE 500
 #define DATA_CAP 10000
 #define GRADIENT_DESCENT_ITERATIONS 100
+#define MULTI_START_SPREAD 4    // LEVENBERG_MARQUARDT_FIT also starts with b this far on either side of 0
+#define MIN_CALIBRATION_TARGET 10000  // ns, reading the clock itself costs tens of nanoseconds
+#define MAX_CALIBRATION_ITERATIONS 1000000000LL
+#define OUTLIER_MADS 3          // trials further than this many (scaled) MADs from the median are rejected
+#define MAD_TO_SIGMA 1.4826     // scales a MAD to a standard deviation for normally distributed data
+#define WEIGHT_FLOOR 0.01       // fraction of the average variance added to every variance before weighting
+#define LEAST_SQUARES_TOLERANCE 2 // closed-form fits within this much of the best score are possible functions
+#define BISECTION_RESOLUTION 8  // find_interval bisects until the budget edge is known to within n / this
+#define SCHEDULE_GROWTH 1.41421356 // the ratio between neighbouring n in the adaptive schedule
+#define SCHEDULE_SEEDS 4        // n sampled in order before the adaptive schedule starts choosing
+#define SCHEDULE_MAX_STEP 2     // the adaptive schedule chooses at most this many n past the largest n sampled so far
+#define FAMILY_RESOLUTION 0.1   // the fitted exponents of a family are rounded to a multiple of this
+#define FAMILY_MAX_LOG_POWER 3  // n^a log^b n only resolves for 0 <= b <= this
+#define STABLE_RANKINGS 5       // the adaptive schedule stops once the best two functions kept their order this many samples
+#define EARLY_STOP_MIN_SAMPLES 8 // early_stop never stops before this many samples
+#define MAX_VARIABLES 5         // the levels of every variable of a sweep are packed into an int
+#define LEVEL_BITS 6            // bits per variable in the index of a point of a sweep
+#define SWEEP_LEVELS 62         // level l of a variable stands for SCHEDULE_GROWTH^l, which stays below INT_MAX
+#define SWEEP_GRID 6            // the first pass of a sweep samples this many levels of every variable
+#define SWEEP_CANDIDATES 3      // a sweep combines at most this many functions of every variable (see fit_sweep)
+#define SWEEP_MODELS 2048       // a sweep fits at most about this many models
+#define EARLY_STOP_STREAK 3     // early_stop stops once the verdict was confident for this many samples in a row
 #define min(x,y) (x < y ? x : y)
 
+// return values of run_sample (these match the worker_pool and in_process_runner return values)
+#define SAMPLE_IN_BUDGET WORKER_IN_BUDGET
+#define SAMPLE_OVER_BUDGET WORKER_OVER_BUDGET
+#define SAMPLE_CRASHED WORKER_CRASHED
+
 using namespace std;
 using std::chrono::duration_cast;
 using std::chrono::nanoseconds;
@@ -33,36 +77,250 @@ using std::chrono::microseconds;
 // ------------------------ PRIVATE ------------------------
 void time_complexity::init(){
     total_time = 0;
+    calibration_iterations = 1;
     dds.clear();
-    ratios.clear();
-    dratios.clear();
+    online_fits.assign(fs.size(), online_fit_t());
+    online_finite.assign(fs.size(), true);
+    online_constant.assign(fs.size(), true);
+    online_first_x.assign(fs.size(), 0);
+    online_count = 0;
+    online_sum_of_weights = 0;
+    largest_observed = 0;
+    confident_streak = 0;
+    confident = false;
+    unused_budget = 0;
+    samples.reset();
+    space_samples.reset();
+    amortized_samples.reset();
+    worst_samples.reset();
     medians.clear();
     means.clear();
     stats.clear();
+    space_stats.clear();
+    amortized_stats.clear();
+    worst_stats.clear();
+}
+
+
+// Runs func(n) and times it. This runs inside of the measured process (either a
+// child forked for this sample, a worker in the pool or the in-process measurement thread).
+// When the request has a target, the number of back-to-back calls grows until one batch
+// runs for at least that long, so that every sample is well above the clock resolution.
+static dd_t measure_sample(function<void(int)> func, sample_request_t request){
+    long long iterations = request.iterations < 1 ? 1 : request.iterations;
+    long long bf;
+    long long af;
+    // the counters of the measuring thread are opened by its first sample that counts events and
+    // kept for the next ones, so that a sample that is interrupted (see in_process_runner) leaks nothing.
+    static thread_local unique_ptr<perf_counters> thread_counters;
+    if(request.count_events && !thread_counters) thread_counters.reset(new perf_counters());
+    perf_counters* counters = request.count_events ? thread_counters.get() : nullptr;
+    long long events[NUM_PERF_COUNTERS];
+    memory_usage memory;
+    operation_timer timer;
+    long long calls = 0;
+
+    // the timer allocates its buffer before the memory is tracked.
+    if(request.time_operations) timer.start();
+    if(request.track_memory){
+        // only the measuring process (or thread, with in_process) counts allocations.
+        memory_usage::enable();
+        memory.start();
+    }
+    while(true){
+        if(counters != nullptr) counters->start();
+        bf = get_time;
+        if(request.time_operations){
+            // the time between two calls is not an operation.
+            for(long long k = 0; k < iterations; ++k){
+                operation_begin();
+                func(request.n);
+            }
+        }else{
+            for(long long k = 0; k < iterations; ++k) func(request.n);
+        }
+        af = get_time;
+        if(counters != nullptr) counters->stop(events);
+        calls += iterations;
+
+        long long elapsed = af - bf;
+        if(elapsed >= request.target || iterations >= MAX_CALIBRATION_ITERATIONS) break;
+
+        // aim a little past the target, but grow by at least 2x and at most 100x per batch.
+        long double scale = elapsed > 0 ? 1.2L * request.target / elapsed : 100;
+        scale = scale < 2 ? 2 : (scale > 100 ? 100 : scale);
+        iterations = (long long) (iterations * scale);
+    }
+
+    // ie. the duration is 0, we need to increment by 1 otherwise
+    // we run for a long time.
+    if(af == bf)
+        af++;
+
+    long long heap_bytes = -1;
+    long long allocations = -1;
+    long long rss_bytes = -1;
+    if(request.track_memory) memory.stop(heap_bytes, allocations, rss_bytes);
+
+    long long operations = -1;
+    long long worst_operation = -1;
+    if(request.time_operations) timer.stop(operations, worst_operation);
+
+    dd_t result = {request.n, (long double) (af - bf) / iterations, iterations};
+    result.heap_bytes = heap_bytes;
+    result.allocations = allocations >= 0 ? (long double) allocations / calls : -1;
+    result.rss_bytes = rss_bytes;
+    result.operations = operations >= 0 ? (long double) operations / calls : -1;
+    result.worst_operation = worst_operation;
+    for(int k = 0; k < NUM_PERF_COUNTERS; ++k){
+        result.counters[k] = (counters != nullptr && events[k] >= 0) ? (long double) events[k] / iterations : -1;
+    }
+
+    return result;
+}
+
+// Restricts the calling process to the given core (Linux only).
+static void pin_to_cpu(int cpu){
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(cpu_set_t), &set);
+#endif
+}
+
+// The value of the cost metric for one call in the sample (wall-clock time when the
+// counter was not available or no operation was marked, and the peak resident set size
+// when the heap was not).
+long double time_complexity::cost_of(const dd_t& sample, cost_metric_t metric){
+    switch(metric){
+    case WALL_TIME:
+        return sample.duration;
+    case HEAP_BYTES:
+        return sample.heap_bytes >= 0 ? sample.heap_bytes : sample.rss_bytes;
+    case ALLOCATIONS:
+        return sample.allocations >= 0 ? sample.allocations : sample.rss_bytes;
+    case RSS_BYTES:
+        return sample.rss_bytes;
+    case AMORTIZED_TIME:
+        return sample.operations > 0 ? sample.duration / sample.operations : sample.duration;
+    case WORST_OPERATION:
+        return sample.operations > 0 ? sample.worst_operation : sample.duration;
+    default:
+        if(sample.counters[metric - 1] < 0) return sample.duration;
+        return sample.counters[metric - 1];
+    }
 }
 
+long double time_complexity::cost_of(const dd_t& sample){
+    return cost_of(sample, cost_metric);
+}
+
+// What to ask the measuring process for to sample func(n).
+sample_request_t time_complexity::request_for(int n){
+    bool count_events = cost_metric >= INSTRUCTIONS && cost_metric <= BRANCH_MISSES;
+    bool track_memory = measure_space || cost_metric >= HEAP_BYTES;
+    bool time_operations = per_operation || cost_metric == AMORTIZED_TIME || cost_metric == WORST_OPERATION;
+    return {n, calibrate ? calibration_iterations : 1, calibrate ? calibration_target : 0, count_events, track_memory, time_operations};
+}
 
-// returns 0 if the function runs within the given time budget,
-// 1 if the functions runs more time than the time budget.
-int time_complexity::run_func_with_budget(function<void(int)> func, int n, int budget){
-    // cout << n << " " << budget << "\n";
-    pid_t child_pid;
-    int rv = 0;
+// Measures func(n) and waits at most budget nanoseconds for it. Returns SAMPLE_IN_BUDGET
+// (and fills in result), SAMPLE_OVER_BUDGET or SAMPLE_CRASHED.
+int time_complexity::run_sample(function<void(int)> func, int n, long long budget, dd_t& result){
+    sample_request_t request = request_for(n);
+    int rv = SAMPLE_CRASHED;
 
-    if((child_pid = fork()) != 0){  // parent
-        // run while the child process is running
+    if(runner != nullptr && runner->usable()){
         long long start_time = get_time;
-        while(waitpid(child_pid, nullptr, WNOHANG) == 0 && rv == 0){
-            if(get_time - start_time > (long long) budget){
-                kill(child_pid, SIGKILL);
-                rv = 1;
-            }
+        rv = runner->run(request, budget, result);
+
+        // the sample overran or crashed: measure it (and everything after it) in a separate process.
+        if(rv != SAMPLE_IN_BUDGET){
+            if(verbose) cout << "\n(n:" << n << " falling back to a separate process)";
+            budget -= get_time - start_time;
         }
-    }else{                          // child
-        func(n);
-        exit(0);
     }
 
+    if(rv != SAMPLE_IN_BUDGET){
+        rv = run_sample_in_child(func, request, budget, result);
+    }
+
+    if(rv == SAMPLE_IN_BUDGET) update_calibration(result);
+
+    return rv;
+}
+
+// Adds the sample to dds, and to the result file of the run.
+void time_complexity::keep(const dd_t& sample){
+    dds.push_back(sample);
+    if(results != nullptr) results->add_sample(sample);
+}
+
+// The next (larger) n starts from the number of calls that would have hit the target for this sample.
+void time_complexity::update_calibration(const dd_t& sample){
+    if(!calibrate) return;
+    calibration_iterations = (long long) ceil(calibration_target / sample.duration);
+    if(calibration_iterations < 1) calibration_iterations = 1;
+}
+
+// Same as run_sample, but always measures in a separate process.
+int time_complexity::run_sample_in_child(function<void(int)> func, sample_request_t request, long long budget, dd_t& result){
+    if(pool != nullptr) return pool->run(request, budget, result);
+
+    long long start_time = get_time;
+    pid_t child_pid = fork();
+    assert(child_pid >= 0);
+
+    if(child_pid == 0){ // child process
+        close(fd[0]);
+        // a single core pins every sample; the adaptive schedule samples one n at a time, so
+        // it also pins to the first of several cores.
+        if(cpus.size() == 1 || (adaptive_schedule && cpus.size() > 0)) pin_to_cpu(cpus[0]);
+        result = measure_sample(func, request);
+        write(fd[1], &result, sizeof(dd_t));
+
+        // _exit so that we do not flush the stdio buffers we inherited from the parent.
+        _exit(0);
+    }
+
+    // parent process: sleep until the child exits or the budget runs out.
+    watcher.watch_child(child_pid, child_pid);
+    bool exited = !watcher.wait(budget - (get_time - start_time)).empty();
+    watcher.unwatch(child_pid);
+
+    if(!exited){
+        kill(child_pid, SIGKILL);
+        waitpid(child_pid, nullptr, 0);
+
+        // the child may have written its result right before we killed it.
+        while(read(fd[0], &result, sizeof(dd_t)) > 0);
+        return SAMPLE_OVER_BUDGET;
+    }
+
+    int status = 0;
+    if(waitpid(child_pid, &status, 0) == -1) exit(1);
+    if(!WIFEXITED(status) || read(fd[0], &result, sizeof(dd_t)) != sizeof(dd_t)){
+        return SAMPLE_CRASHED;
+    }
+
+    return SAMPLE_IN_BUDGET;
+}
+
+// Measures one call to func(n) for find_interval with the computation_budget, and keeps the
+// sample in probes when it ran within the budget. Returns what run_sample returns.
+int time_complexity::run_probe(function<void(int)> func, int n){
+    dd_t result;
+    // a probe times a single call (never a calibrated batch), so that the computation_budget
+    // bounds the cost of one call.
+    sample_request_t request = request_for(n);
+    request.iterations = 1;
+    request.target = 0;
+    // probes are expected to overrun, so they never run in-process.
+    int rv = run_sample_in_child(func, request, computation_budget, result);
+    if(rv != SAMPLE_IN_BUDGET) return rv;
+
+    probes.push_back(result);
+    update_calibration(result);
     return rv;
 }
 
@@ -80,272 +338,1460 @@ string get_file_name(){
     return buf;
 }
 
-void time_complexity::save_to_file(vector<rd_t> vals[], vector<guess_collection_t> guesses){
-    string dir = data_directory + "/" + current_test_name;
-    mkdir(dir.c_str(), 0744);
+// Describes the fit of every candidate (and the rows of the ratio table that the converging
+// fit uses) for save_to_file. The fit points straight into the columns of the table.
+void time_complexity::describe_fit(string name, cost_metric_t metric, int st, int end, const vector<function_type_t>& candidates, sample_table& table, 
+    const vector<convergence_data_t>& found, result_fit_t& fit){
+    int num_functions = candidates.size();
+    int rows = table.size();
+
+    fit.name = name;
+    fit.metric = metric;
+    fit.solver = fit_solver;
+    fit.st = st;
+    fit.end = end;
+    int64_t* fits = table.found();
+    for(int i = 0; i < num_functions; ++i){
+        fit.functions.push_back(candidates[i].name);
+        fits[i] = 0;
+        for(int k = 0; k < found.size(); ++k) fits[i] = fits[i] || found[k].name == candidates[i].name;
+    }
+    fit.a = table.guess(0);
+    fit.b = table.guess(1);
+    fit.c = table.guess(2);
+    fit.d = table.guess(3);
+    fit.error = table.guess(4);
+    fit.found = fits;
+
+    // the rows outside of the ones the converging fit uses are left out (the fit is done with them).
+    fit.rows = rows;
+    fit.n = table.n();
+    for(int i = 0; i < num_functions; ++i){
+        double* ratio = table.ratio(i);
+        for(int j = 0; j < rows; ++j){
+            if(j < table.first(i) || j > table.last(i)) ratio[j] = NAN;
+        }
+        fit.ratios.push_back(ratio);
+    }
+}
+
+// Saves a fit to the result file of the run, and as a new JSON file under data_directory/<name of the fit>.
+void time_complexity::save_to_file(const result_fit_t& fit){
+    if(results != nullptr) results->add_fit(fit);
+
+    if(save_json){
+        string dir = data_directory + "/" + fit.name;
+        mkdir(dir.c_str(), 0744);
+
+        ofstream ofs = ofstream();
+        ofs.open(dir + "/" + get_file_name()); // create a new file with the given unique name (using current time)
+        export_json(fit, ofs);
+    }
+}
+
+// Collects one sample per n in [st, end), one after another, until the budget runs out.
+void time_complexity::collect_sequentially(function<void(int)> func, int st, int end, int jmp){
+    // Protect against overflow
+    int collected = 0;
+    bool out_of_budget = false;
+    for(int i = st; i < end && i > 0 && !out_of_budget; i += jmp){
+        dd_t sample;
+        // n that find_interval probed within the interval are in dds already.
+        bool probed = find_if(probes.begin(), probes.end(), [i](const dd_t& probe) -> bool {return probe.n == i;}) != probes.end();
+        for(int trial = 0; trial < trials && !out_of_budget && !probed; ++trial){
+            long long start_time = get_time;
+            int rv = run_sample(func, i, total_budget - total_time, sample);
+            long long end_time = get_time;
+
+            // we ran out of budget (or the function crashed), stop collecting.
+            if(rv != SAMPLE_IN_BUDGET){
+                total_time += end_time - start_time;
+                if(verbose && rv == SAMPLE_CRASHED) cout << "\n(n:" << i << " crashed)";
+                out_of_budget = true;
+                break;
+            }
+
+            keep(sample);
+            total_time += (end_time - start_time); // include process startup time
+            if(total_budget < total_time) out_of_budget = true;
+            // the verdict is clear, so the rest of the budget is not needed.
+            if(observe(sample)) out_of_budget = true;
+        }
+        if(out_of_budget) break;
+        collected++;
+
+        // Double the jump size each time we reach a power of 2
+        if(collected % DATA_BEFORE_DOUBLE == 0){
+            jmp *= 2;
+        }
+
+        // If we reach the data cap, then we will break
+        if(collected >= DATA_CAP){
+            break;
+        }
+
+        // Print test information if verbose is true.
+        if(verbose && !probed){
+            cout << left << "\n(n:" << setw(5) << i << ", Time:" << setw(7) << (double) sample.duration / 1000 << "s";
+            if(cost_metric != WALL_TIME) cout << ", Cost:" << setw(7) << (double) cost_of(sample);
+            cout << ")";
+        }
+    }
+}
+
+// The Bayesian information criterion of a closed-form fit with the given number of
+// parameters, over weighted samples (see fit_least_squares). Lower is better.
+static long double information_criterion(long double error, int weighted, int parameters){
+    return weighted * log(error) + parameters * log(weighted);
+}
 
-    ofstream ofs = ofstream();
-    ofs.open(dir + "/" + get_file_name()); // create a new file with the given unique name (using current time)
+// Adds the sample to the closed-form fits of every complexity function when early_stop is
+// on (the same fits as fit_least_squares, over every trial so far, with relative weights).
+// Since the information criterion approximates the log of the evidence for a fit, the
+// functions are weighed by e^(-score / 2), and the best one (among the functions that do
+// not converge to zero) is as likely as its share of the total weight. Returns true, and
+// sets confident, once that share stayed at least confidence for EARLY_STOP_STREAK samples
+// in a row (after at least EARLY_STOP_MIN_SAMPLES samples).
+bool time_complexity::observe(const dd_t& sample){
+    if(!early_stop || confident) return confident;
+
+    long double y = cost_of(sample);
+    if(!(y > 0) || isinf(y)) return false;
+    long double w = 1 / (y * y);
+    online_count++;
+    online_sum_of_weights += w;
+    if(sample.n > largest_observed) largest_observed = sample.n;
+
+    for(int i = 0; i < fs.size(); ++i){
+        long double x = fs[i].function_base(sample.n, 0, INT_MAX);
+        if(isnan(x) || isinf(x)) online_finite[i] = false;
+        if(online_count == 1) online_first_x[i] = x;
+        if(x != online_first_x[i]) online_constant[i] = false;
+        add_point(online_fits[i], x, y, w);
+    }
+    if(online_count < EARLY_STOP_MIN_SAMPLES) return false;
+
+    // every sample weighs 1 / cost^2, so the weighted sum of the squared costs is the count.
+    long double sum_of_weights = online_sum_of_weights;
+    vector<long double> scores;
+    long double best_score = INFINITY;
+    for(int i = 0; i < fs.size(); ++i){
+        if(!online_finite[i]) continue;
+        linear_fit_t fit = online_proportional(online_fits[i]);
+        long double score = information_criterion(fit.residual * sum_of_weights / online_count, online_count, 1);
+        linear_fit_t with_overhead = online_line(online_fits[i]);
+        long double overhead_score = information_criterion(with_overhead.residual * sum_of_weights / online_count, online_count, 2);
+        if(!online_constant[i] && with_overhead.intercept >= 0 && overhead_score < score){
+            fit = with_overhead;
+            score = overhead_score;
+        }
+        if(isnan(score) || isnan(fit.slope)) continue;
+
+        scores.push_back(score);
+        long double largest = fs[i].function_base(largest_observed, 0, INT_MAX);
+        long double a = fit.slope > 0 ? fit.slope * largest / (fit.intercept + fit.slope * largest) : 0;
+        if(a >= zero) best_score = min(best_score, score);
+    }
+    if(isinf(best_score)) return false;
 
+    long double total = 0;
+    for(int i = 0; i < scores.size(); ++i) total += exp(-(scores[i] - best_score) / 2);
+    long double share = 1 / total;
+
+    confident_streak = share >= confidence ? confident_streak + 1 : 0;
+    confident = confident_streak >= EARLY_STOP_STREAK;
+    if(verbose && confident) cout << "\n(n:" << sample.n << ", the best function explains " << (double) share * 100 << "% of the evidence)";
+    return confident;
+}
+
+// Ranks the complexity functions by how well c * f(n) explains the cost of the samples
+// collected so far (the sum of the squared errors of the logarithms), best first. Sets
+// scales[i] to the best log(c) for f_i. Functions that are not positive at every sampled
+// n are left out.
+vector<int> time_complexity::rank_functions(vector<long double>& scales){
     int num_functions = fs.size();
+    vector<long double> errors(num_functions, 0);
+    vector<int> ranking;
+    scales.assign(num_functions, 0);
 
-    // CREATE THE JSON FILE:
-    ofs << "{";
+    for(int i = 0; i < num_functions; ++i){
+        vector<long double> residuals;
+        bool positive = true;
+        for(int j = 0; j < dds.size() && positive; ++j){
+            long double f = fs[i].function_base(dds[j].n, 0, INT_MAX);
+            long double cost = cost_of(dds[j]);
+            positive = f > 0 && !isinf(f) && !isnan(f);
+            if(cost > 0) residuals.push_back(log(cost) - log(f));
+        }
+        if(!positive || residuals.size() == 0) continue;
 
-    // Write guess:
-    ofs << "\"predictions\":{";
+        for(int j = 0; j < residuals.size(); ++j) scales[i] += residuals[j] / residuals.size();
+        for(int j = 0; j < residuals.size(); ++j) errors[i] += pow(residuals[j] - scales[i], 2);
+        ranking.push_back(i);
+    }
 
-    ofs << "\"function string\":\"" << FUNCTION_STR << "\",";
-    for(int function_num = 0; function_num < num_functions; ++function_num){ // for each function:
-        ofs << "\"" << fs[function_num].name << "\":{";
-        
-        ofs << "\"guess\":["
-            << guesses[function_num].a << ","
-            << guesses[function_num].b << ","
-            << guesses[function_num].c << ","
-            << guesses[function_num].d << "],";
-        ofs << "\"error\":" << guesses[function_num].error;
+    stable_sort(ranking.begin(), ranking.end(), [&errors](int a, int b) -> bool {return errors[a] < errors[b];});
+    return ranking;
+}
 
-        ofs << "}";
-        if(function_num < num_functions - 1) ofs << ",";
+// Collects samples at n = st * SCHEDULE_GROWTH^k below end (from n = 2, where log n > 0). After the first SCHEDULE_SEEDS n,
+// every next n is the one where the two best fitting functions (see rank_functions) predict
+// the most different costs, among the n that the remaining budget can afford and that are
+// at most SCHEDULE_MAX_STEP n past the largest n so far. Since the models drift apart as n
+// grows, this mostly grows n geometrically towards the edge of the budget, and then fills in
+// the gaps that are left.
+// Collecting stops once the best two functions keep their order for STABLE_RANKINGS n, or
+// once no n is affordable. The samples are sorted by n at the end.
+void time_complexity::collect_adaptively(function<void(int)> func, int st, int end){
+    vector<int> schedule;
+    for(long double n = max(st, 2); n < end && n < INT_MAX; n *= SCHEDULE_GROWTH){
+        if(schedule.size() == 0 || (int) n != schedule.back()) schedule.push_back((int) n);
     }
-    ofs << "},";
+    vector<bool> sampled(schedule.size(), false);
+
+    int collected = 0;
+    int largest = -1;
+    int stable = 0;
+    int leader = -1;
+    int runner_up = -1;
+    int last_n = st;
+    long long last_elapsed = 0;
+
+    while(collected < schedule.size() && total_time < total_budget){
+        int next = -1;
+        if(collected < SCHEDULE_SEEDS){
+            next = collected;
+        }else{
+            vector<long double> scales;
+            vector<int> ranking = rank_functions(scales);
+            if(ranking.size() < 2) break;
+
+            // stop once the ranking settles.
+            if(ranking[0] == leader && ranking[1] == runner_up){
+                if(++stable >= STABLE_RANKINGS) break;
+            }else{
+                stable = 0;
+            }
+            leader = ranking[0];
+            runner_up = ranking[1];
+
+            long double best_disagreement = -1;
+            for(int k = 0; k < schedule.size() && k <= largest + SCHEDULE_MAX_STEP; ++k){
+                if(sampled[k]) continue;
+                int n = schedule[k];
+                long double f_leader = fs[leader].function_base(n, 0, INT_MAX);
+                long double f_runner_up = fs[runner_up].function_base(n, 0, INT_MAX);
+                if(!(f_leader > 0) || !(f_runner_up > 0) || isinf(f_leader) || isinf(f_runner_up)) continue;
+
+                // the last sample took last_elapsed; assume the costlier of the two models scales it.
+                long double growth = max(f_leader / fs[leader].function_base(last_n, 0, INT_MAX),
+                                         f_runner_up / fs[runner_up].function_base(last_n, 0, INT_MAX));
+                long double predicted = trials * last_elapsed * (growth > 1 ? growth : 1);
+                if(predicted > (total_budget - total_time) / 2) continue;
+
+                long double disagreement = fabsl((scales[leader] + log(f_leader)) - (scales[runner_up] + log(f_runner_up)));
+                if(disagreement > best_disagreement){
+                    best_disagreement = disagreement;
+                    next = k;
+                }
+            }
+            if(next < 0) break;
+        }
 
-    // Write data:
-    ofs << "\"data\":{";
-    for(int function_num = 0; function_num < num_functions; ++function_num){ // for each function:
-        ofs << "\"" << fs[function_num].name << "\":{";
+        int n = schedule[next];
+        dd_t sample;
+        bool out_of_budget = false;
+        long long start_time = get_time;
+        for(int trial = 0; trial < trials; ++trial){
+            long long trial_start = get_time;
+            int rv = run_sample(func, n, total_budget - total_time, sample);
+            total_time += get_time - trial_start; // include process startup time
+
+            // we ran out of budget (or the function crashed), stop collecting.
+            if(rv != SAMPLE_IN_BUDGET){
+                if(verbose && rv == SAMPLE_CRASHED) cout << "\n(n:" << n << " crashed)";
+                out_of_budget = true;
+                break;
+            }
+            keep(sample);
 
-        ofs << "\"x\":[";
-        for(int i = 0; i < vals[function_num].size(); ++i){
-            ofs << vals[function_num][i].n;
-            if(i < vals[function_num].size() - 1) ofs << ",";
+            // the verdict is clear, so the rest of the budget is not needed.
+            if(observe(sample)){
+                out_of_budget = true;
+                break;
+            }
         }
-        ofs << "],";
-        
-        ofs << "\"y\":[";
-        for(int i = 0; i < vals[function_num].size(); ++i){
-            ofs << vals[function_num][i].ratio;
-            if(i < vals[function_num].size() - 1) ofs << ",";
+        if(out_of_budget) break;
+
+        sampled[next] = true;
+        largest = max(largest, next);
+        collected++;
+        last_n = n;
+        last_elapsed = (get_time - start_time) / trials;
+
+        // Print test information if verbose is true.
+        if(verbose){
+            cout << left << "\n(n:" << setw(5) << n << ", Time:" << setw(7) << (double) sample.duration / 1000 << "s";
+            if(cost_metric != WALL_TIME) cout << ", Cost:" << setw(7) << (double) cost_of(sample);
+            cout << ")";
+        }
+    }
+
+    stable_sort(dds.begin(), dds.end(), [](const dd_t& a, const dd_t& b) -> bool {return a.n < b.n;});
+}
+
+// Collects samples for [st, end) like collect_sequentially, but keeps one child per
+// core in cpus busy at all times. Every child is pinned to its own core and reports back
+// through its own pipe. The samples are sorted by n once the budget runs out.
+void time_complexity::collect_in_parallel(function<void(int)> func, int st, int end, int jmp){
+    int num_slots = cpus.size();
+    vector<pid_t> pids(num_slots, -1);
+    vector<int> pipes(num_slots, -1);
+    vector<int> ns(num_slots, 0);
+    int busy = 0;
+    int dispatched = 0;
+    int trial = 0;
+    bool dispatching = true;
+    int i = st;
+    long long start_time = get_time;
+    auto stop_running = [&]() {
+        for(int slot = 0; slot < num_slots; ++slot){
+            if(pids[slot] == -1) continue;
+            watcher.unwatch(slot);
+            kill(pids[slot], SIGKILL);
+            waitpid(pids[slot], nullptr, 0);
+            close(pipes[slot]);
+            pids[slot] = -1;
+        }
+    };
+
+    while(dispatching || busy > 0){
+        // hand out the next n to every idle core.
+        for(int slot = 0; slot < num_slots && dispatching; ++slot){
+            if(pids[slot] != -1) continue;
+            if(!(i < end && i > 0) || dispatched >= DATA_CAP){
+                dispatching = false;
+                break;
+            }
+
+            sample_request_t request = request_for(i);
+            int slot_fd[2];
+            assert(pipe(slot_fd) != -1);
+
+            pid_t child_pid = fork();
+            assert(child_pid >= 0);
+            if(child_pid == 0){ // child process
+                close(slot_fd[0]);
+                pin_to_cpu(cpus[slot]);
+                dd_t result = measure_sample(func, request);
+                write(slot_fd[1], &result, sizeof(dd_t));
+                _exit(0);
+            }
+
+            close(slot_fd[1]);
+            pids[slot] = child_pid;
+            pipes[slot] = slot_fd[0];
+            ns[slot] = i;
+            watcher.watch_child(slot, child_pid);
+            busy++;
+
+            // every n is handed out once per trial.
+            if(++trial < trials) continue;
+            trial = 0;
+            dispatched++;
+
+            // Double the jump size each time we hand out DATA_BEFORE_DOUBLE values
+            if(dispatched % DATA_BEFORE_DOUBLE == 0){
+                jmp *= 2;
+            }
+            i += jmp;
+        }
+
+        vector<int> ready = watcher.wait(total_budget - (get_time - start_time));
+
+        // out of budget: stop everything that is still running.
+        if(ready.empty()){
+            stop_running();
+            break;
+        }
+
+        for(int k = 0; k < ready.size(); ++k){
+            int slot = ready[k];
+            int status = 0;
+            dd_t sample;
+            watcher.unwatch(slot);
+            waitpid(pids[slot], &status, 0);
+
+            if(WIFEXITED(status) && read(pipes[slot], &sample, sizeof(dd_t)) == sizeof(dd_t)){
+                keep(sample);
+                update_calibration(sample);
+                if(verbose) cout << left << "\n(n:" << setw(5) << sample.n << ", Time:" << setw(7) << (double) sample.duration / 1000 << "s, CPU:" << cpus[slot] << ")";
+                if(observe(sample)) dispatching = false;
+            }else{
+                // larger n would crash as well.
+                if(verbose) cout << "\n(n:" << ns[slot] << " crashed)";
+                dispatching = false;
+            }
+
+            close(pipes[slot]);
+            pids[slot] = -1;
+            busy--;
         }
-        ofs << "]}";
 
-        if(function_num < num_functions - 1) ofs << ",";
+        // the verdict is clear: the samples that are still running are not needed.
+        if(confident){
+            stop_running();
+            break;
+        }
     }
-    ofs << "}";
-    ofs << "}";
+
+    sort(dds.begin(), dds.end(), [](const dd_t& a, const dd_t& b) -> bool {return a.n < b.n;});
+    total_time = get_time - start_time;
 }
 
-// semi-open intervals [st, end) 
-void time_complexity::complexity_table_generator(function<void(int)> func, int st, int end, int jmp){
-restart:
-    init();
+// The value of a variable of a sweep at the given level.
+static int level_value(int level){
+    return (int) llround(pow(SCHEDULE_GROWTH, level));
+}
 
-    int num_functions = fs.size();
+// The index that stands for the point with the given levels (the n of its sample).
+static int level_index(const vector<int>& levels){
+    int index = 0;
+    for(int d = 0; d < levels.size(); ++d) index |= levels[d] << (d * LEVEL_BITS);
+    return index;
+}
 
-    unsigned long long bf;
-    unsigned long long af;
-    int duration;
-    
-    int count = 0;
+// Measures the point with the given levels of a sweep within the computation_budget (or
+// what is left of the total budget), and adds it to dds when it ran within the budget.
+// Returns what run_sample returns.
+int time_complexity::run_grid_sample(function<void(int)> func, const vector<int>& levels){
+    dd_t sample;
+    long long start_time = get_time;
+    int rv = run_sample(func, level_index(levels), min(computation_budget, total_budget - total_time), sample);
+    total_time += get_time - start_time;
+    if(rv != SAMPLE_IN_BUDGET){
+        if(verbose && rv == SAMPLE_CRASHED) cout << "\n(point " << level_index(levels) << " crashed)";
+        return rv;
+    }
 
-    ostringstream oss;
+    keep(sample);
+    if(verbose){
+        cout << left << "\n(";
+        for(int d = 0; d < levels.size(); ++d) cout << "x" << d << ":" << setw(6) << level_value(levels[d]) << ", ";
+        cout << "Time:" << setw(7) << (double) sample.duration / 1000 << "s)";
+    }
+    return rv;
+}
 
-    
-    // Protect against overflow
-    for(int i = st; i < end && i > 0; i += jmp){
-        pid_t child_pid;
-        bool ignore_duration = false;
-        long long start_time = get_time;
-        long long end_time;
-
-        // fork
-        child_pid = fork();
-        assert(child_pid >= 0);
-
-        if(child_pid == 0){ // child process
-            close(fd[0]);
-
-            bf = get_time;
-            func(i);
-            af = get_time;
-
-            // ie. the duration is 0, we need to increment by 1 otherwise
-            // we run for a long time.
-            if(af == bf) 
-                af++;
-
-            write(fd[1], &bf, sizeof(long long));
-            write(fd[1], &af, sizeof(long long));
-
-            exit(0);
-        }else{ // parent process
-            int status = 1;
-            int* status_ptr = &status;
-            pid_t end_pid = 0;
-            bool run = true;
-            
-            while(run){
-                end_pid = waitpid(child_pid, status_ptr, WNOHANG);
-                if(end_pid == -1){
-                    exit(1);
-                }else if(end_pid != 0){
-                    read(fd[0], &bf, sizeof(long long));
-                    read(fd[0], &af, sizeof(long long));
-                    run = false;
-                }
+// Collects the samples of a sweep. Every variable takes the values SCHEDULE_GROWTH^level. First,
+// the level of every variable doubles (with the others at 1) until one call runs over the
+// computation_budget, which bounds the levels of that variable. The grid then starts with
+// SWEEP_GRID evenly spaced levels per variable and is refined (halving the spacing) while the
+// budget lasts. Every pass samples the points with the lowest levels (relative to their
+// bounds) first, and skips the points that were already sampled and the points above one
+// that ran over the budget, since they cannot be cheaper. Every point is sampled with the
+// computation_budget, so that one expensive point cannot use up the total budget.
+void time_complexity::collect_grid(function<void(int)> func, int dimensions){
+    set<int> sampled;
+    vector<vector<int>> over_budget;
+    vector<int> bounds(dimensions, 0);
+    for(int d = 0; d < dimensions; ++d){
+        vector<int> levels(dimensions, 0);
+        for(levels[d] = 0; levels[d] < SWEEP_LEVELS && total_time < total_budget; levels[d] += 2){
+            if(sampled.count(level_index(levels)) != 0) continue;
+            if(run_grid_sample(func, levels) != SAMPLE_IN_BUDGET) break;
+            sampled.insert(level_index(levels));
+            bounds[d] = levels[d];
+        }
+    }
 
-                // kill child
-                if(get_time - start_time >= total_budget - total_time){
-                    kill(child_pid, SIGKILL);
-                    total_time += get_time - start_time;
-                    run = false;
-                    ignore_duration = true;
+    for(int resolution = SWEEP_GRID; total_time < total_budget; resolution = 2 * resolution - 1){
+        vector<vector<int>> axes(dimensions);
+        bool finest = true;
+        long long num_points = 1;
+        for(int d = 0; d < dimensions; ++d){
+            for(int i = 0; i < resolution; ++i){
+                int level = (int) lround((double) i * bounds[d] / (resolution - 1));
+                if(axes[d].empty() || axes[d].back() != level) axes[d].push_back(level);
+            }
+            finest = finest && axes[d].size() == bounds[d] + 1;
+            num_points *= axes[d].size();
+        }
+        if(num_points > DATA_CAP) break;
+
+        // every combination of the levels, from the cheapest.
+        vector<vector<int>> points(1);
+        for(int d = 0; d < dimensions; ++d){
+            vector<vector<int>> next;
+            for(int i = 0; i < points.size(); ++i){
+                for(int j = 0; j < axes[d].size(); ++j){
+                    next.push_back(points[i]);
+                    next.back().push_back(axes[d][j]);
                 }
             }
+            points.swap(next);
+        }
+        vector<double> height(points.size(), 0);
+        for(int i = 0; i < points.size(); ++i){
+            for(int d = 0; d < dimensions; ++d) height[i] += bounds[d] > 0 ? (double) points[i][d] / bounds[d] : 0;
+        }
+        vector<int> order(points.size());
+        for(int i = 0; i < order.size(); ++i) order[i] = i;
+        stable_sort(order.begin(), order.end(), [&height](int a, int b) -> bool {return height[a] < height[b];});
+
+        for(int i = 0; i < order.size() && total_time < total_budget && dds.size() < DATA_CAP; ++i){
+            const vector<int>& levels = points[order[i]];
+            if(sampled.count(level_index(levels)) != 0) continue;
+
+            bool dominated = false;
+            for(int j = 0; j < over_budget.size() && !dominated; ++j){
+                dominated = true;
+                for(int d = 0; d < dimensions; ++d) dominated = dominated && levels[d] >= over_budget[j][d];
+            }
+            if(dominated) continue;
 
-            end_time = get_time;
+            sampled.insert(level_index(levels));
+            if(run_grid_sample(func, levels) != SAMPLE_IN_BUDGET) over_budget.push_back(levels);
         }
-        
-        if(ignore_duration) break;
 
-        duration = af - bf;
-        dds.push_back({i, duration});
-        total_time += (end_time - start_time); // include process startup time
-        count++;
-        if(total_budget < total_time) break;
+        if(finest) break;
+    }
+}
 
-        // Double the jump size each time we reach a power of 2
-        if(dds.size() % DATA_BEFORE_DOUBLE == 0){
-            jmp *= 2;
+// The median of the values (the upper one for an even count).
+static long double median_of(vector<long double> values){
+    nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+// Combines the trials of every n (the trials of an n are next to each other in dds) into
+// one sample. Trials further than OUTLIER_MADS scaled MADs from the median cost are
+// rejected, and the trial with the median cost among the rest stands for the n, along with
+// the minimum, MAD and variance of the trials. Also fills in medians and means.
+void time_complexity::reduce_trials(){
+    vector<dd_t> reduced;
+    medians.clear();
+    means.clear();
+
+    int j = 0;
+    while(j < dds.size()){
+        int k = j;
+        while(k < dds.size() && dds[k].n == dds[j].n) k++;
+
+        vector<long double> costs;
+        vector<long double> deviations;
+        for(int t = j; t < k; ++t) costs.push_back(cost_of(dds[t]));
+        long double median = median_of(costs);
+        for(int t = 0; t < costs.size(); ++t) deviations.push_back(fabsl(costs[t] - median));
+        long double mad = median_of(deviations);
+
+        vector<dd_t> kept;
+        vector<long double> kept_costs;
+        long double minimum = costs[0];
+        for(int t = j; t < k; ++t){
+            minimum = min(minimum, costs[t - j]);
+            if(deviations[t - j] > OUTLIER_MADS * MAD_TO_SIGMA * mad) continue;
+            kept.push_back(dds[t]);
+            kept_costs.push_back(costs[t - j]);
         }
 
-        // If we reach the data cap, then we will break
-        if(dds.size() >= DATA_CAP){
-            break;
+        long double mean = 0;
+        long double variance = 0;
+        for(int t = 0; t < kept_costs.size(); ++t) mean += kept_costs[t] / kept_costs.size();
+        for(int t = 0; t < kept_costs.size(); ++t) variance += pow(kept_costs[t] - mean, 2) / kept_costs.size();
+
+        // the kept trial that has the median cost.
+        long double kept_median = median_of(kept_costs);
+        dd_t sample = kept[0];
+        for(int t = 0; t < kept.size(); ++t){
+            if(kept_costs[t] == kept_median) sample = kept[t];
         }
+        sample.trials = kept.size();
+        sample.minimum = minimum;
+        sample.mad = mad;
+        sample.variance = variance;
 
-        // Print test information if verbose is true.
-        if(verbose){
-            cout << left << "\n(n:" << setw(5) << i << ", Time:" << setw(7) << (double) duration / 1000 << "s)";
+        if(verbose && kept.size() < k - j){
+            cout << "\n(n:" << sample.n << ", rejected " << (k - j) - kept.size() << " of " << k - j << " trials)";
+        }
+
+        reduced.push_back(sample);
+        medians.push_back(kept_median);
+        means.push_back(mean);
+        j = k;
+    }
+
+    dds = reduced;
+}
+
+// The weighted mean of the squared errors of the converging function (see
+// time_complexity::convergence_function) over the given ratios, with its analytic gradient
+// for analytic_gradient_descent. With z = (x - c)s, s = 1 / (max_b sigmoid(b)) and
+// S = 1 / (1 + e^-z), f = (2 - a) + 2(a - 1)S, so
+//     df/da = 2S - 1
+//     df/db = 2(a - 1) S(1 - S) (x - c) ds/db, where ds/db = -(1 - sigmoid(b)) / (max_b sigmoid(b)).
+// S is evaluated for every x at once with the batched logistic kernel.
+struct convergence_loss{
+    int length;
+    const double* x;
+    const double* y;
+    const double* w;
+    int c;
+    long double max_b;
+    simd_level_t simd;
+    shared_ptr<vector<double>> logistics;
+
+    convergence_loss(int length, const double* x, const double* y, const double* w, int c, long double max_b, simd_level_t simd)
+        : length(length), x(x), y(y), w(w), c(c), max_b(max_b), simd(simd), logistics(make_shared<vector<double>>(length)){}
+
+    long double operator()(const long double args[], long double gradient[]){
+        long double a = args[0];
+        long double sigmoid_b = 1 / (1 + exp(-args[1]));
+        long double s = 1 / (max_b * sigmoid_b);
+        long double ds_db = -(1 - sigmoid_b) / (max_b * sigmoid_b);
+
+        double* S = logistics->data();
+        logistic(length, x, 0, 1, c, s, S, simd);
+
+        long double sum_of_error_squared = 0;
+        long double sum_of_weights = 0;
+        gradient[0] = 0;
+        gradient[1] = 0;
+        for(int i = 0; i < length; ++i){
+            long double error = y[i] - ((2 - a) + 2 * (a - 1) * S[i]);
+            if(isnan(error)) continue;
+            sum_of_error_squared += w[i] * error * error;
+            sum_of_weights += w[i];
+            gradient[0] += -2 * w[i] * error * (2 * S[i] - 1);
+            gradient[1] += -2 * w[i] * error * 2 * (a - 1) * S[i] * (1 - S[i]) * (x[i] - c) * ds_db;
+        }
+
+        gradient[0] /= sum_of_weights;
+        gradient[1] /= sum_of_weights;
+        return sum_of_error_squared / sum_of_weights;
+    }
+};
+
+// The residuals sqrt(w)(y - f(x)) of the converging function over the given ratios, and
+// their jacobian, for levenberg_marquardt (see convergence_loss for the partials of f).
+// NaN ratios have no residual.
+// The sum of the squared residuals over the sum of the weights is the loss of convergence_loss.
+struct convergence_residuals{
+    int length;
+    const double* x;
+    const double* y;
+    shared_ptr<vector<double>> root_w;
+    int c;
+    long double max_b;
+    simd_level_t simd;
+    shared_ptr<vector<double>> logistics;
+
+    convergence_residuals(int length, const double* x, const double* y, const double* w, int c, long double max_b, simd_level_t simd)
+        : length(length), x(x), y(y), root_w(make_shared<vector<double>>(length)), c(c), max_b(max_b), simd(simd),
+          logistics(make_shared<vector<double>>(length)){
+        for(int i = 0; i < length; ++i) (*root_w)[i] = isnan(y[i]) ? 0 : sqrt(w[i]);
+    }
+
+    void operator()(const long double args[], long double out[]) const{
+        long double a = args[0];
+        double* S = logistics->data();
+        logistic(length, x, 0, 1, c, 1 / (max_b * (1 / (1 + exp(-args[1])))), S, simd);
+        for(int i = 0; i < length; ++i) out[i] = (*root_w)[i] * (y[i] - ((2 - a) + 2 * (a - 1) * S[i]));
+    }
+
+    void jacobian(const long double args[], long double out[]) const{
+        long double a = args[0];
+        long double sigmoid_b = 1 / (1 + exp(-args[1]));
+        long double s = 1 / (max_b * sigmoid_b);
+        long double ds_db = -(1 - sigmoid_b) / (max_b * sigmoid_b);
+
+        double* S = logistics->data();
+        logistic(length, x, 0, 1, c, s, S, simd);
+        for(int i = 0; i < length; ++i){
+            out[2 * i] = -(*root_w)[i] * (2 * S[i] - 1);
+            out[2 * i + 1] = -(*root_w)[i] * 2 * (a - 1) * S[i] * (1 - S[i]) * (x[i] - c) * ds_db;
         }
     }
+};
+
+// Fills in out[i] = f(n[i]) for a column of n, in one call when f has a batch_base.
+static void evaluate(const function_type_t& f, int length, const double* n, int st, int end, long double* out){
+    if(f.batch_base){
+        f.batch_base(length, n, st, end, out);
+        return;
+    }
+    for(int i = 0; i < length; ++i) out[i] = f.function_base(n[i], st, end);
+}
+
+// semi-open intervals [st, end) 
+void time_complexity::complexity_table_generator(function<void(int)> func, int st, int end, int jmp){
+restart:
+    init();
+
+    // the probes of find_interval are samples too.
+    for(int i = 0; i < probes.size(); ++i){
+        if(probes[i].n >= st && probes[i].n < end){
+            keep(probes[i]);
+            observe(probes[i]);
+        }
+    }
+    int probed = dds.size();
+
+    if(adaptive_schedule){
+        collect_adaptively(func, st, end);
+    }else if(cpus.size() > 1){
+        collect_in_parallel(func, st, end, jmp);
+    }else{
+        collect_sequentially(func, st, end, jmp);
+    }
+
+    int collected = (dds.size() - probed) / trials;
+    unused_budget = confident && total_time < total_budget ? total_budget - total_time : 0;
+    if(verbose && confident) cout << "\n(stopped early, " << (double) unused_budget / 1000000000 << "s of the budget unused)";
+    stable_sort(dds.begin(), dds.end(), [](const dd_t& a, const dd_t& b) -> bool {return a.n < b.n;});
+    reduce_trials();
 
     if(verbose) cout << "\n\nTotal time: " << (double) (total_time + preprocessing_time) / 1000 << "\n\n";
 
     if(dds.size() < MIN_TABLE_VALUES && jmp == 1){ // we cannot reformat to allow for more data values
         cout << ("Increase total budget.\n. Too few values collected.\n");
         exit(0);
-    }else if(dds.size() < MIN_TABLE_VALUES){ // we go back to the start of the function with start and jmp = 1.
-        // this occurs when we observe exponential or super-exponential functions
+    }else if(collected < MIN_TABLE_VALUES && jmp != 1){ // we go back to the start of the function with start and jmp = 1.
+        // this occurs when we observe exponential or super-exponential functions (the probes
+        // below the old start become samples, and are not measured again)
         if(verbose)
             cout << "\n\nRestarting with new interval\n";
+        if(results != nullptr) results->reset();
         st = 1;
         jmp = 1;
         end = INT_MAX;
         goto restart;
     }
 
-    // ---------- RATIO TABLE ----------
-    ratios = vector<vector<long double>>(num_functions, vector<long double>(count, 0));
-    vector<rd_t> rds[num_functions];
-    oss << "Ratio Table:\n";
-    oss << left << setw(12) << " ";
-    for(int i = 0; i < num_functions; ++i){
-        oss << setw(20) << fs[i].name << setw(2);
+    fit_samples(st, end);
+}
+
+// Fits the complexity functions against every metric of the test to the samples in dds
+// (once their trials are combined).
+void time_complexity::fit_samples(int st, int end){
+    if(cost_metric >= INSTRUCTIONS && cost_metric <= BRANCH_MISSES && dds.size() > 0 && dds[0].counters[cost_metric - 1] < 0){
+        cout << "Performance counters are not available, fitting against wall-clock time instead.\n";
     }
-    oss << "\n";
 
-    int c = 0;
+    if((measure_space || cost_metric >= HEAP_BYTES) && dds.size() > 0 && dds[0].heap_bytes < 0){
+        cout << "Heap usage is not available, fitting against the peak resident set size instead.\n";
+    }
 
-    double normalize_vals[num_functions];
-    for(int i = 0; i < num_functions; ++i){
-        normalize_vals[i] = 1;
-        for(auto it = dds.begin(); it != dds.end(); ++it){
-            long double pos = (long double) it->duration / fs[i].function_base(it->n, st, end);
+    if(per_operation && dds.size() > 0 && dds[dds.size() - 1].operations <= 0){
+        cout << "No operations were marked (call operation_done() after every operation), fitting against the time of a call instead.\n";
+    }
+
+    // the sampling processes are gone, so the fits may run on threads. The fits (time, then
+    // the same samples fitted against the memory they used, then per operation) run
+    // concurrently, and print (and are saved) in that order once all of them are done.
+    vector<cost_metric_t> metrics = {cost_metric};
+    vector<sample_table*> tables = {&samples};
+    vector<vector<convergence_data_t>*> founds = {&stats};
+    vector<string> names = {current_test_name};
+    if(measure_space){
+        metrics.push_back(space_metric);
+        tables.push_back(&space_samples);
+        founds.push_back(&space_stats);
+        names.push_back(current_test_name + "-space");
+    }
+    if(per_operation){
+        metrics.insert(metrics.end(), {AMORTIZED_TIME, WORST_OPERATION});
+        tables.insert(tables.end(), {&amortized_samples, &worst_samples});
+        founds.insert(founds.end(), {&amortized_stats, &worst_stats});
+        names.insert(names.end(), {current_test_name + "-amortized", current_test_name + "-worst"});
+    }
+
+    int num_threads = fit_threads > 0 ? fit_threads : thread::hardware_concurrency();
+    fitters = new thread_pool(num_threads > 0 ? num_threads : 1);
+    vector<string> outputs(metrics.size());
+    vector<result_fit_t> fits(metrics.size());
+    fitters->for_each(metrics.size(), [&, st, end](int k) {
+        ostringstream out;
+        fit_costs(st, end, metrics[k], *tables[k], *founds[k], names[k], fits[k], out);
+        outputs[k] = out.str();
+    });
+    delete fitters;
+    fitters = nullptr;
+    for(int k = 0; k < outputs.size(); ++k){
+        cout << outputs[k];
+        if(save_data) save_to_file(fits[k]);
+    }
+}
+
+// Stores the fit of function i in the guess columns of the table.
+static void store_guess(sample_table& table, int i, const guess_collection_t& guess){
+    table.guess(0)[i] = guess.a;
+    table.guess(1)[i] = guess.b;
+    table.guess(2)[i] = guess.c;
+    table.guess(3)[i] = guess.d;
+    table.guess(4)[i] = guess.error;
+}
+
+// Fits every complexity function (and the best function of every family) against the given
+// cost of the samples in dds and adds the functions that fit to found. The samples are laid out in table
+// first, which the fits read in place and fit points into (see describe_fit), under name.
+// What the fit prints goes to out. The functions are fitted concurrently on the fitters,
+// and added to found in the order of fs.
+void time_complexity::fit_costs(int st, int end, cost_metric_t metric, sample_table& table, vector<convergence_data_t>& found, string name, 
+    result_fit_t& fit, ostream& out){
+    int count = dds.size();
+    ostringstream oss;
+
+    table.reserve(count, fs.size() + families.size());
+    table.resize(count);
+    double* n = table.n();
+    long double* cost = table.cost();
+    long double* variance = table.variance();
+    long double* cost_weight = table.cost_weight();
+    long double* log_n = table.log_n();
+    long double* log_cost = table.log_cost();
+    for(int j = 0; j < count; ++j){
+        n[j] = dds[j].n;
+        cost[j] = cost_of(dds[j], metric);
+        variance[j] = dds[j].variance;
+        cost_weight[j] = cost[j] > 0 ? 1 / (cost[j] * cost[j] + variance[j]) : 0;
+        log_n[j] = log(dds[j].n);
+        log_cost[j] = cost[j] > 0 ? log(cost[j]) : NAN;
+    }
+
+    // the functions of the test, and the best function of every family.
+    vector<function_type_t> candidates(fs);
+    vector<int> parameters(fs.size(), 0);
+    fit_families(table, candidates, parameters, out);
+    int num_functions = candidates.size();
+
+    // ---------- RATIO TABLE ----------
+    fitters->for_each(num_functions, [&](int i) {
+        long double* basis = table.basis(i);
+        double* ratio = table.ratio(i);
+        double* weight = table.ratio_weight(i);
+        vector<long double> f(count);
+        evaluate(candidates[i], count, n, 0, INT_MAX, basis);
+        evaluate(candidates[i], count, n, st, end, &f[0]);
+
+        double normalize_val = 1;
+        for(int j = 0; j < count; ++j){
+            long double pos = cost[j] / f[j];
             if(pos != 0 && !isnan(pos) && !isinf(pos)){
-                normalize_vals[i] = pos;
+                normalize_val = pos;
                 break;
             }
         }
+
+        for(int j = 0; j < count; ++j){
+            ratio[j] = cost[j] / f[j] / normalize_val;
+            if(isinf(ratio[j])) ratio[j] = NAN;
+            // the variance of the ratio follows from the variance of the cost (the weight is filled in below).
+            weight[j] = variance[j] / (f[j] * normalize_val * f[j] * normalize_val);
+        }
+
+        // the ratio is only fitted from where it first comes close to 1.
+        int first = 0;
+        while(first < count && (ratio[first] < 0.9 || ratio[first] > 1.1)) first++;
+        while(first < count && isnan(ratio[first])) first++;
+        int last = count - 1;
+        while(last >= first && isnan(ratio[last])) last--;
+        table.first(i) = first;
+        table.last(i) = last;
+
+        // weigh each n by the inverse of its variance (every n weighs the same with a single trial).
+        int kept = 0;
+        long double average_variance = 0;
+        for(int j = first; j <= last; ++j) kept += !isnan(ratio[j]);
+        for(int j = first; j <= last; ++j){
+            if(!isnan(ratio[j]) && !isnan(weight[j]) && !isinf(weight[j])) average_variance += weight[j] / kept;
+        }
+
+        for(int j = 0; j < count; ++j){
+            if(j < first || j > last || isnan(ratio[j])){
+                weight[j] = 0;
+                continue;
+            }
+            weight[j] = average_variance > 0 ? average_variance / (weight[j] + WEIGHT_FLOOR * average_variance) : 1;
+            if(isnan(weight[j]) || isinf(weight[j])) weight[j] = 0;
+        }
+    });
+
+    oss << "Ratio Table:\n";
+    oss << left << setw(12) << " ";
+    for(int i = 0; i < num_functions; ++i){
+        oss << setw(20) << candidates[i].name << setw(2);
     }
-    for(auto it = dds.begin(); it != dds.end(); ++it){
-        oss << setw(10) << it->n << setw(2);
+    oss << "\n";
+    for(int j = 0; j < count; ++j){
+        oss << setw(10) << dds[j].n << setw(2);
         for(int i = 0; i < num_functions; ++i){
-            // if(i == 0) rds[i] = vector<rd_t>();
-            ratios[i][c] = (long double) it->duration / fs[i].function_base(it->n, st, end);
-            ratios[i][c] /= normalize_vals[i];
-            rds[i].push_back({it->n, ratios[i][c]});
-            oss << setw(20) << setprecision(5) << fixed << ratios[i][c] << setw(2);
+            oss << setw(20) << setprecision(5) << fixed << table.ratio(i)[j] << setw(2);
         }
-        c++;
         oss << "\n";
     }
 
     if(verbose){
-        cout << oss.str();
+        out << oss.str();
     }
 
     // ---------- FINDING MODEL ----------
-    vector<rd_t> vals[num_functions];
-    int max_sz = 0;
+    if(fit_solver == LEAST_SQUARES_FIT){
+        fit_least_squares(candidates, parameters, table, found, out);
+        describe_fit(name, metric, st, end, candidates, table, found, fit);
+        return;
+    }
+
+    vector<convergence_data_t> fits(num_functions);
+    vector<bool> converged(num_functions, false);
+    vector<string> lines(num_functions);
+    fitters->for_each(num_functions, [&](int i) {
+        // the ratio never came close to 1, so there is nothing to fit.
+        if(table.first(i) > table.last(i)){
+            store_guess(table, i, {0, 0, 0, 0, INFINITY});
+            return;
+        }
+
+        // the rows of the ratio that are fitted, straight from the table (NaN ratios in between weigh nothing).
+        int length = table.last(i) - table.first(i) + 1;
+        const double* x = table.n() + table.first(i);
+        const double* y = table.ratio(i) + table.first(i);
+        const double* w = table.ratio_weight(i) + table.first(i);
+
+        int start = x[0];
+        long double max_b = (long double) x[length - 1] / 5; // this will be passed in so that b stays within the range of 0 to this value
+        simd_level_t simd = this->simd;
+        function<long double(long double*)> mse = MSE(length, x, y, w,
+            [start, max_b, simd](int length, const double* x, const long double* args, double* out) {convergence_function(length, x, args, start, max_b, out, simd);}, simd);
+        
+        long double first_guess[2] = {y[length - 1], (long double) 0};
+        vector<long double> guess;
+
+        ostringstream line;
+        char buf[29];
+        sprintf(buf, "(%.5Lf, %.5Lf)", first_guess[0], first_guess[1]);
+        if(show_gradient) line << left << setw(15) << candidates[i].name << setprecision(5) << "Initial guess: " << setw(30) << buf;
+        if(fit_solver == LEVENBERG_MARQUARDT_FIT){
+            // DAMPED LEAST SQUARES: Minimize the same error from a few starts, with the residuals sqrt(w)(y - f(x)).
+            convergence_residuals residuals(length, x, y, w, start, max_b, simd);
+            levenberg_marquardt lm(residuals, 2, length, GRADIENT_DESCENT_ITERATIONS);
+            lm.set_jacobian([residuals](const long double* args, long double* out) {residuals.jacobian(args, out);});
+            lm.set_guess(first_guess);
+            for(int side = -1; side <= 1; side += 2){
+                long double other_start[2] = {first_guess[0], (long double) side * MULTI_START_SPREAD};
+                lm.add_start(other_start);
+            }
+            guess = lm.run();
+            if(show_gradient) line << right << setw(12) << "Evaluations: " << setw(6) << lm.get_evaluations();
+        }else{
+            // GRADIENT DESCENT: Minimize the mean-squared-error of the given function (mse) with its analytic gradient.
+            convergence_loss loss(length, x, y, w, start, max_b, simd);
+            analytic_gradient_descent<2, convergence_loss> grd(loss, GRADIENT_DESCENT_ITERATIONS);
+            grd.set_guess(first_guess);
+            guess = grd.run();
+        }
+        sprintf(buf, "(%.5Lf, %.5Lf)", guess[0], guess[1]);
+        if(show_gradient) line << right << setw(20) << " After: " << left << setw(30) << buf;
+        long double error = mse(&guess[0]);
+        if(show_gradient) line << right << setw(20) << "Error: " << left << setw(15) << error << "\n";
+
+        store_guess(table, i, {guess[0], guess[1], start, max_b, error});
+        fits[i] = {candidates[i].name, guess[0], error, 0};
+        // if the error is low enough, we conclude that the ratio converges:
+        converged[i] = error < convergence_error;
+        lines[i] = line.str();
+    });
+
     for(int i = 0; i < num_functions; ++i){
-        int j = 0;
-        while(j < count && (rds[i][j].ratio < 0.9 || rds[i][j].ratio > 1.1)) j++; // keep adding one to j until we get to 1.
-        for(; j < count; ++j){
-            if(isnan(rds[i][j].ratio) || isinf(rds[i][j].ratio)) continue;
-            // cout << "Added: " << rds[i][j].n << " " << rds[i][j].ratio << "\n";
-            vals[i].push_back(rds[i][j]);
-            max_sz = max_sz < vals[i].size() ? vals[i].size(): max_sz;
+        out << lines[i];
+        if(converged[i]) found.push_back(fits[i]);
+    }
+
+    describe_fit(name, metric, st, end, candidates, table, found, fit);
+}
+
+// Fits the exponents of every family to the logarithm of the cost in the table, in closed form
+// (weighing every sample by how precise its logarithm is), and adds the function that every
+// family resolves to to the candidates, along with the number of exponents that were
+// fitted. A function that is already one of the candidates (or that has no name, see
+// function_family_t) is not added.
+void time_complexity::fit_families(sample_table& table, vector<function_type_t>& candidates, vector<int>& parameters, ostream& out){
+    int count = table.size();
+    vector<long double> w(count);
+    for(int j = 0; j < count; ++j){
+        // the variance of log(cost) is about the variance of the cost over cost^2.
+        w[j] = table.cost_weight()[j] * table.cost()[j] * table.cost()[j];
+    }
+
+    for(int k = 0; k < families.size(); ++k){
+        int num_exponents = families[k].num_exponents;
+        vector<vector<long double>> columns(num_exponents, vector<long double>(count));
+        vector<const long double*> regressors(num_exponents);
+        vector<long double> row(num_exponents);
+        for(int j = 0; j < count; ++j){
+            families[k].regressors(table.n()[j], &row[0]);
+            for(int e = 0; e < num_exponents; ++e) columns[e][j] = row[e];
         }
+        for(int e = 0; e < num_exponents; ++e) regressors[e] = &columns[e][0];
+
+        vector<long double> coefficients(num_exponents + 1);
+        long double residual = fit_linear_model(count, num_exponents, &regressors[0], table.log_cost(), &w[0], &coefficients[0]);
+        if(isnan(residual)) continue;
+
+        function_type_t resolved = families[k].resolve(&coefficients[1]);
+        if(show_gradient){
+            out << left << setw(15) << families[k].name << "exponents: ";
+            for(int e = 0; e < num_exponents; ++e) out << setw(10) << setprecision(5) << (double) coefficients[e + 1];
+            out << "-> " << (resolved.name != "" ? resolved.name : "(left out)") << "\n";
+        }
+        if(resolved.name == "") continue;
+
+        bool known = false;
+        for(int i = 0; i < candidates.size(); ++i) known = known || candidates[i].name == resolved.name;
+        if(known) continue;
+        candidates.push_back(resolved);
+        parameters.push_back(num_exponents);
     }
+}
 
-    const long double* x[num_functions][max_sz];
-    long double y[num_functions][max_sz];
-    for(int i = 0; i < num_functions; ++i){
-        for(int j = 0; j < vals[i].size(); ++j){
-            x[i][j] = new long double[1]{(const long double) vals[i][j].n};
-            y[i][j] = vals[i][j].ratio;
+// The name of the complexity function we guess from the functions that converged.
+string time_complexity::best_guess(const vector<convergence_data_t>& found){
+    string guess_name = "NOT FOUND";
+
+    // closed-form fits are scored: guess the function that fits best.
+    if(fit_solver == LEAST_SQUARES_FIT){
+        int best = -1;
+        for(int i = 0; i < found.size(); ++i){
+            if(found[i].a >= zero && (best < 0 || found[i].score < found[best].score)) best = i;
+        }
+        if(best >= 0){
+            guess_name = found[best].name;
+            guess_name.erase(guess_name.begin());
+            guess_name = "\u0398" + guess_name;
         }
     }
 
-    vector<guess_collection_t> guesses;
+    for(int i = 0; i < found.size() && fit_solver != LEAST_SQUARES_FIT; ++i){
+        // We guess the last function that doesn't converge to zero (there is likely only one function like this).
+        if(found[i].a >= zero){
+            guess_name = found[i].name;
+            guess_name.erase(guess_name.begin());
+            guess_name = "\u0398" + guess_name;
+        }
+    }
+
+    if(guess_name == "NOT FOUND" && found.size() != 0){
+        guess_name = found[0].name; // take the lowest big O.
+    }
+
+    return guess_name;
+}
+
+// Prints the functions that fit the samples of another fit than the time fit (see
+// show_possible_big_o) and the guess from them, as "<what> guess: ...".
+void time_complexity::print_guess(string what, const vector<convergence_data_t>& found){
+    string lower = what;
+    transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if(show_possible_big_o) cout << "Possible Big O functions (" << lower << "): \n";
+    for(int i = 0; i < found.size(); ++i){
+        if(show_possible_big_o) printf("  - %s : (a = %.5Lf, error = %.5Lf) \n", found[i].name.c_str(), found[i].a, found[i].error);
+    }
+    cout << what << " guess: " << best_guess(found) << "\n";
+}
+
+// Fits cost = c1 * f(n) and cost = c0 + c1 * f(n) to the samples for every candidate f,
+// in closed form with weighted least squares. The weights make the errors relative
+// (1 / cost^2), and noisier n count for less (see trials). c0 stands for the overhead of
+// a call, so it may not be negative. The error of a fit is the weighted mean of the squared
+// relative errors, and its "a" is how much of the cost at the largest n comes from c1 * f(n).
+// Since a free c0 lets a function that grows a little too fast (or too slow) fit as well,
+// fits are scored by the Bayesian information criterion, count * log(error) + parameters *
+// log(count), which only keeps c0 when it explains the samples much better. Functions that
+// fit within the convergence_error or within LEAST_SQUARES_TOLERANCE of the best score are
+// added to found. A function that overflows at any of the samples cannot fit. The exponents
+// of a function that fit_families fitted count as parameters too. Stores {c0, c1, 0, 0, error}
+// in the guess columns of the table for every function. The functions are fitted concurrently on the fitters, and what the fit
+// prints goes to out in the order of the candidates.
+void time_complexity::fit_least_squares(const vector<function_type_t>& candidates, const vector<int>& parameters, sample_table& table, 
+    vector<convergence_data_t>& found, ostream& out){
+    int count = table.size();
+    const long double* y = table.cost();
+    const long double* w = table.cost_weight();
+    vector<convergence_data_t> fits;
+
+    int weighted = 0;
+    long double sum_of_weights = 0;
+    long double sum_of_squares = 0;
+    for(int j = 0; j < count; ++j){
+        if(w[j] > 0) weighted++;
+        sum_of_weights += w[j];
+        sum_of_squares += w[j] * y[j] * y[j];
+    }
+
+    // the slope of log(cost) against log(n) is the degree of a polynomial cost.
+    vector<long double> ones(count, 1);
+    linear_fit_t log_log = fit_line(count, table.log_n(), table.log_cost(), &ones[0]);
+    if(show_gradient) out << "Log-log slope: " << setprecision(5) << (double) log_log.slope << " (R^2 = " << (double) log_log.r_squared << ")\n";
+
+    int num_functions = candidates.size();
+    fits.resize(num_functions);
+    vector<string> lines(num_functions);
+    fitters->for_each(num_functions, [&](int i) {
+        const long double* x = table.basis(i);
+        bool finite = true;
+        bool constant = true;
+        for(int j = 0; j < count; ++j){
+            finite = finite && !isnan(x[j]) && !isinf(x[j]);
+            constant = constant && x[j] == x[0];
+        }
+
+        linear_fit_t fit = fit_proportional(count, x, y, w);
+        long double error = fit.residual * sum_of_weights / sum_of_squares;
+        long double score = information_criterion(error, weighted, 1 + parameters[i]);
+
+        // a constant f already is an overhead.
+        linear_fit_t with_overhead = fit_line(count, x, y, w);
+        long double overhead_error = with_overhead.residual * sum_of_weights / sum_of_squares;
+        long double overhead_score = information_criterion(overhead_error, weighted, 2 + parameters[i]);
+        if(!constant && with_overhead.intercept >= 0 && overhead_score < score){
+            fit = with_overhead;
+            error = overhead_error;
+            score = overhead_score;
+        }
+
+        if(!finite || isnan(error) || isnan(fit.slope)){
+            store_guess(table, i, {0, 0, 0, 0, INFINITY});
+            fits[i] = {candidates[i].name, 0, INFINITY, INFINITY};
+            return;
+        }
+
+        long double largest = x[count - 1];
+        long double a = fit.slope > 0 ? fit.slope * largest / (fit.intercept + fit.slope * largest) : 0;
+        if(isnan(a)) a = 0;
+
+        if(show_gradient){
+            ostringstream line;
+            line << left << setw(15) << candidates[i].name << setprecision(5) << "c0: " << setw(15) << (double) fit.intercept 
+                 << "c1: " << setw(15) << (double) fit.slope << "a: " << setw(10) << (double) a << "Error: " << setw(15) << (double) error
+                 << "Score: " << (double) score << "\n";
+            lines[i] = line.str();
+        }
+
+        store_guess(table, i, {fit.intercept, fit.slope, 0, 0, error});
+        fits[i] = {candidates[i].name, a, error, score};
+    });
+
+    long double best_score = INFINITY;
     for(int i = 0; i < num_functions; ++i){
-        int start = vals[i][0].n;
-        long double max_b = (long double) vals[i][vals[i].size() - 1].n / 5; // this will be passed in so that b stays within the range of 0 to this value
-        function<long double(long double*)> mse = MSE(vals[i].size(), x[i], y[i], 
-            [start, max_b](const long double* x, long double* args) -> long double {return convergence_function(x, args, start, max_b);});
-        
-        // GRADIENT DESCENT: Minimize the mean-squared-error of the given function (mse). mse takes 2 arguments.
-        gradient_descent grd(mse, 2, GRADIENT_DESCENT_ITERATIONS);
-        grd.set_verbose(false);
-        long double first_guess[2] = {vals[i][vals[i].size() - 1].ratio, (long double) 0};
-        grd.set_guess(first_guess);
+        out << lines[i];
+        if(fits[i].a >= zero) best_score = min(best_score, fits[i].score);
+    }
 
-        char buf[29];
-        sprintf(buf, "(%.5Lf, %.5Lf)", grd.get_guess()[0], grd.get_guess()[1]);
-        if(show_gradient) cout << left << setw(15) << fs[i].name << setprecision(5) << "Initial guess: " << setw(30) << buf;
-        grd.run();
-        sprintf(buf, "(%.5Lf, %.5Lf)", grd.get_guess()[0], grd.get_guess()[1]);
-        if(show_gradient) cout << right << setw(20) << " After: " << left << setw(30) << buf;
-        long double error = mse(&grd.get_guess()[0]);
-        if(show_gradient) cout << right << setw(20) << "Error: " << left << setw(15) << error << "\n";
-
-        guesses.push_back({grd.get_guess()[0], grd.get_guess()[1], start, max_b, error});
-        // if the error is low enough, we conclude that the ratio converges:
-        if(error < convergence_error){
-            stats.push_back({fs[i].name, grd.get_guess()[0], error});
+    for(int i = 0; i < candidates.size(); ++i){
+        if(fits[i].error < convergence_error || fits[i].score <= best_score + LEAST_SQUARES_TOLERANCE){
+            found.push_back(fits[i]);
+        }
+    }
+}
+
+// The name of a complexity function as a term of the given variable: without "O(" and ")",
+// and with every n replaced by the variable ("log m" for "O(log n)").
+static string term_name(string name, const string& variable){
+    if(name.compare(0, 2, "O(") == 0 && name[name.size() - 1] == ')') name = name.substr(2, name.size() - 3);
+    string term;
+    for(int i = 0; i < name.size(); ++i){
+        bool alone = name[i] == 'n' && (i == 0 || !isalpha(name[i - 1])) && (i + 1 == name.size() || !isalpha(name[i + 1]));
+        term += alone ? variable : string(1, name[i]);
+    }
+    return term;
+}
+
+// The name of the product of the given terms, with logarithmic factors last (as in m log n).
+static string product_name(const vector<string>& factors){
+    string fast, slow;
+    for(int i = 0; i < factors.size(); ++i){
+        string& name = factors[i].find("log") == string::npos ? fast : slow;
+        name += (name != "" ? " " : "") + factors[i];
+    }
+    return fast + (fast != "" && slow != "" ? " " : "") + slow;
+}
+
+// Fits sums of products of the complexity functions of every variable to the samples of a
+// sweep, from products such as cost = c0 + c1 f(n) g(m) to sums such as cost = c0 + c1 f(n)
+// + c2 g(m) (and every grouping of the variables in between, such as O(a b + c)), over the
+// few functions of every variable that fit the samples along its axis best. Like
+// fit_least_squares, the fits are closed-form with relative errors, c0 is only kept when it
+// explains the samples much better (by the Bayesian information criterion), and it may not
+// be negative. Every other coefficient must be positive. A function that is constant over
+// the samples (O(1), or any function of a variable that was not varied) leaves its variable
+// out of the model, and models with the same name are fitted once. The models that fit
+// within the convergence_error or within LEAST_SQUARES_TOLERANCE of the best score are added
+// to found, best first. Returns the verdict, and prints what every term of it adds to the
+// most expensive sample to out (which shows the term that dominates).
+string time_complexity::fit_sweep(const vector<string>& variables, vector<convergence_data_t>& found, ostream& out){
+    int dimensions = variables.size();
+    int count = dds.size();
+    int num_functions = fs.size();
+
+    vector<vector<int>> x(dimensions, vector<int>(count));
+    vector<long double> y(count), w(count);
+    int weighted = 0;
+    long double sum_of_weights = 0;
+    long double sum_of_squares = 0;
+    for(int j = 0; j < count; ++j){
+        for(int d = 0; d < dimensions; ++d) x[d][j] = level_value((dds[j].n >> (d * LEVEL_BITS)) & ((1 << LEVEL_BITS) - 1));
+        y[j] = cost_of(dds[j]);
+        w[j] = y[j] > 0 ? 1 / (y[j] * y[j]) : 0;
+        if(w[j] > 0) weighted++;
+        sum_of_weights += w[j];
+        sum_of_squares += w[j] * y[j] * y[j];
+    }
+
+    // basis[d][f] is f over the values of variable d, and terms[d][f] its name ("" when it is constant).
+    vector<vector<vector<long double>>> basis(dimensions, vector<vector<long double>>(num_functions, vector<long double>(count)));
+    vector<vector<string>> terms(dimensions, vector<string>(num_functions));
+    for(int d = 0; d < dimensions; ++d){
+        for(int f = 0; f < num_functions; ++f){
+            bool constant = true;
+            for(int j = 0; j < count; ++j){
+                basis[d][f][j] = fs[f].function_base(x[d][j], 1, INT_MAX);
+                constant = constant && basis[d][f][j] == basis[d][f][0];
+            }
+            terms[d][f] = constant ? "" : term_name(fs[f].name, variables[d]);
+        }
+    }
+
+    // candidates[d] are the functions of variable d that models combine, best first: the
+    // SWEEP_CANDIDATES functions that fit the samples along its axis (every other variable at
+    // 1) best on their own, with or without an overhead. Since every function of every variable
+    // in every grouping is a model, there would otherwise be num_functions^dimensions times
+    // Bell(dimensions) of them. The variables with the most candidates then lose their worst
+    // ones until at most about SWEEP_MODELS models are left.
+    vector<vector<int>> candidates(dimensions);
+    for(int d = 0; d < dimensions; ++d){
+        vector<long double> axis_y, axis_w;
+        vector<int> axis;
+        for(int j = 0; j < count; ++j){
+            bool on_axis = true;
+            for(int e = 0; e < dimensions; ++e) on_axis = on_axis && (e == d || x[e][j] == 1);
+            if(on_axis) axis.push_back(j);
+        }
+        if(axis.size() < MIN_TABLE_VALUES){
+            axis.clear();
+            for(int j = 0; j < count; ++j) axis.push_back(j);
+        }
+        for(int j = 0; j < axis.size(); ++j){
+            axis_y.push_back(y[axis[j]]);
+            axis_w.push_back(w[axis[j]]);
+        }
+        int axis_weighted = 0;
+        long double axis_sum_of_weights = 0, axis_sum_of_squares = 0;
+        for(int j = 0; j < axis.size(); ++j){
+            if(axis_w[j] > 0) axis_weighted++;
+            axis_sum_of_weights += axis_w[j];
+            axis_sum_of_squares += axis_w[j] * axis_y[j] * axis_y[j];
+        }
+
+        vector<pair<long double, int>> ranked;
+        bool constant_ranked = false;
+        for(int f = 0; f < num_functions; ++f){
+            long double score = INFINITY;
+            long double fit[2];
+            if(terms[d][f] == ""){
+                if(constant_ranked) continue;
+                constant_ranked = true;
+                long double error = fit_linear_model(axis.size(), 0, nullptr, &axis_y[0], &axis_w[0], fit) * axis_sum_of_weights / axis_sum_of_squares;
+                score = information_criterion(error, axis_weighted, 1);
+            }else{
+                vector<long double> column(axis.size());
+                bool finite = true;
+                for(int j = 0; j < axis.size(); ++j){
+                    column[j] = basis[d][f][axis[j]];
+                    finite = finite && !isnan(column[j]) && !isinf(column[j]);
+                }
+                const long double* regressor = &column[0];
+                for(int overhead = 0; overhead < 2 && finite; ++overhead){
+                    long double error = fit_linear_model(axis.size(), 1, &regressor, &axis_y[0], &axis_w[0], fit, overhead == 1) * axis_sum_of_weights / axis_sum_of_squares;
+                    if(fit[1] > 0 && fit[0] >= 0 && !isnan(error)) score = min(score, information_criterion(error, axis_weighted, 1 + overhead));
+                }
+            }
+            if(!isnan(score) && !isinf(score)) ranked.push_back({score, f});
+        }
+        stable_sort(ranked.begin(), ranked.end(), [](const pair<long double, int>& a, const pair<long double, int>& b) -> bool {return a.first < b.first;});
+        for(int k = 0; k < ranked.size() && k < SWEEP_CANDIDATES; ++k) candidates[d].push_back(ranked[k].second);
+        if(candidates[d].empty()) candidates[d].push_back(0);
+    }
+
+    // the number of groupings of the variables (the Bell number of dimensions) bounds the groupings of every combination.
+    vector<long long> bell(1, 1);
+    for(int k = 0; k < dimensions; ++k){
+        vector<long long> row(1, bell.back());
+        for(int i = 0; i < bell.size(); ++i) row.push_back(row.back() + bell[i]);
+        bell.swap(row);
+    }
+    while(true){
+        long long num_models = bell[0];
+        int widest = 0;
+        for(int d = 0; d < dimensions; ++d){
+            num_models *= candidates[d].size();
+            if(candidates[d].size() > candidates[widest].size()) widest = d;
+        }
+        if(num_models <= SWEEP_MODELS || candidates[widest].size() == 1) break;
+        candidates[widest].pop_back();
+    }
+
+    // every grouping of one function per variable into a sum of products (every variable
+    // in a term is in groups[d], -1 for the variables that are left out), named after its terms.
+    vector<vector<int>> functions_of, groups_of;
+    vector<vector<string>> terms_of;
+    vector<string> names;
+    set<string> named;
+    vector<int> choices(dimensions, 0);
+    vector<int> functions(dimensions);
+    for(bool done = false; !done; ){
+        for(int d = 0; d < dimensions; ++d) functions[d] = candidates[d][choices[d]];
+        vector<int> varied;
+        for(int d = 0; d < dimensions; ++d){
+            if(terms[d][functions[d]] != "") varied.push_back(d);
+        }
+
+        // the groupings of the varied variables, as restricted growth strings.
+        vector<int> group(varied.size(), 0);
+        for(bool grouped = false; !grouped; ){
+            int num_groups = 0;
+            for(int i = 0; i < group.size(); ++i) num_groups = max(num_groups, group[i] + 1);
+            vector<vector<string>> factors(num_groups);
+            vector<int> groups(dimensions, -1);
+            for(int i = 0; i < varied.size(); ++i){
+                factors[group[i]].push_back(terms[varied[i]][functions[varied[i]]]);
+                groups[varied[i]] = group[i];
+            }
+            vector<string> products;
+            string name;
+            for(int g = 0; g < num_groups; ++g){
+                products.push_back(product_name(factors[g]));
+                name += (g > 0 ? " + " : "") + products[g];
+            }
+            name = "O(" + (name == "" ? "1" : name) + ")";
+            if(named.insert(name).second){
+                functions_of.push_back(functions);
+                groups_of.push_back(groups);
+                terms_of.push_back(products);
+                names.push_back(name);
+            }
+
+            // the next grouping: raise the last digit that may grow (at most one more than the digits before it).
+            grouped = true;
+            for(int i = (int) group.size() - 1; i > 0 && grouped; --i){
+                int highest = 0;
+                for(int k = 0; k < i; ++k) highest = max(highest, group[k]);
+                if(group[i] <= highest){
+                    group[i]++;
+                    for(int k = i + 1; k < group.size(); ++k) group[k] = 0;
+                    grouped = false;
+                }
+            }
+        }
+
+        // the next combination of candidates.
+        done = true;
+        for(int d = 0; d < dimensions && done; ++d){
+            choices[d] = (choices[d] + 1) % candidates[d].size();
+            done = choices[d] == 0;
         }
     }
 
-    if(save_data) save_to_file(vals, guesses);
+    int num_models = names.size();
+    vector<convergence_data_t> fits(num_models);
+    vector<vector<long double>> coefficients(num_models); // c0, then the coefficient of every term
+    vector<vector<vector<long double>>> columns(num_models); // every term over the samples
+    fitters->for_each(num_models, [&](int i) {
+        fits[i] = {names[i], 0, INFINITY, INFINITY};
+        int num_terms = terms_of[i].size();
+        columns[i].assign(num_terms, vector<long double>(count, 1));
+        vector<const long double*> regressors(num_terms);
+        for(int d = 0; d < dimensions; ++d){
+            if(groups_of[i][d] < 0) continue;
+            vector<long double>& column = columns[i][groups_of[i][d]];
+            for(int j = 0; j < count; ++j) column[j] *= basis[d][functions_of[i][d]][j];
+        }
+        for(int k = 0; k < num_terms; ++k){
+            regressors[k] = &columns[i][k][0];
+            for(int j = 0; j < count; ++j){
+                if(isnan(columns[i][k][j]) || isinf(columns[i][k][j])) return;
+            }
+        }
+
+        vector<long double> fit(num_terms + 1);
+        long double error = fit_linear_model(count, num_terms, &regressors[0], &y[0], &w[0], &fit[0], false) * sum_of_weights / sum_of_squares;
+        long double score = information_criterion(error, weighted, num_terms);
+
+        // O(1) already is an overhead.
+        vector<long double> with_overhead(num_terms + 1);
+        long double overhead_error = fit_linear_model(count, num_terms, &regressors[0], &y[0], &w[0], &with_overhead[0]) * sum_of_weights / sum_of_squares;
+        long double overhead_score = information_criterion(overhead_error, weighted, num_terms + 1);
+        if(num_terms > 0 && with_overhead[0] >= 0 && overhead_score < score){
+            fit = with_overhead;
+            error = overhead_error;
+            score = overhead_score;
+        }
 
-    // Free all allocated space.
-    for(int fn = 0; fn < num_functions; ++fn){
-        for(int j = 0; j < vals[fn].size(); ++j){
-            delete[] x[fn][j];
+        bool positive = true;
+        for(int k = 1; k <= num_terms; ++k) positive = positive && fit[k] > 0;
+        if(!positive || isnan(error)) return;
+
+        // how much of the cost of the most expensive sample the terms explain.
+        int largest = max_element(y.begin(), y.end()) - y.begin();
+        long double explained = 0;
+        for(int k = 0; k < num_terms; ++k) explained += fit[k + 1] * columns[i][k][largest];
+        long double a = explained / (fit[0] + explained);
+
+        coefficients[i] = fit;
+        fits[i] = {names[i], isnan(a) ? 0 : a, error, score};
+    });
+
+    long double best_score = INFINITY;
+    int best = -1;
+    for(int i = 0; i < num_models; ++i){
+        if(fits[i].a >= zero && fits[i].score < best_score){
+            best_score = fits[i].score;
+            best = i;
         }
-    } 
+    }
+
+    vector<int> order;
+    for(int i = 0; i < num_models; ++i){
+        if(fits[i].error < convergence_error || fits[i].score <= best_score + LEAST_SQUARES_TOLERANCE) order.push_back(i);
+    }
+    stable_sort(order.begin(), order.end(), [&fits](int a, int b) -> bool {return fits[a].score < fits[b].score;});
+    for(int k = 0; k < order.size(); ++k){
+        int i = order[k];
+        found.push_back(fits[i]);
+        if(!show_gradient) continue;
+        out << left << setw(25) << names[i] << setprecision(5) << "c: ";
+        for(int c = 0; c < coefficients[i].size(); ++c) out << setw(13) << (double) coefficients[i][c];
+        out << "a: " << setw(10) << (double) fits[i].a << "Error: " << setw(15) << (double) fits[i].error << "Score: " << (double) fits[i].score << "\n";
+    }
+
+    if(best < 0) return found.size() != 0 ? found[0].name : "NOT FOUND";
+
+    // what every term of the verdict adds to the most expensive sample, the largest first.
+    int largest = max_element(y.begin(), y.end()) - y.begin();
+    vector<pair<long double, string>> shares;
+    long double total = coefficients[best][0];
+    for(int k = 0; k < terms_of[best].size(); ++k){
+        shares.push_back({coefficients[best][k + 1] * columns[best][k][largest], terms_of[best][k]});
+        total += shares.back().first;
+    }
+    if(coefficients[best][0] > 0) shares.push_back({coefficients[best][0], "overhead"});
+    stable_sort(shares.begin(), shares.end(), [](const pair<long double, string>& a, const pair<long double, string>& b) -> bool {return a.first > b.first;});
+
+    out << "Dominant term: " << shares[0].second << " (" << setprecision(3) << (double) (100 * shares[0].first / total) << "% of the cost at ";
+    for(int d = 0; d < dimensions; ++d) out << (d > 0 ? ", " : "") << variables[d] << " = " << x[d][largest];
+    for(int k = 1; k < shares.size(); ++k) out << "; " << shares[k].second << ": " << (double) (100 * shares[k].first / total) << "%";
+    out << ")\n";
+
+    return "\u0398" + names[best].substr(1);
 }
 
 // Represents a generic converging function. "c" represents the point (c, 1) that f(x) always intersects -- this will be a constant value that depends on
@@ -356,32 +1802,51 @@ long double time_complexity::convergence_function(const long double* x, long dou
     return 2 * (args[0] - 1) * (1 / (1 + exp(-1 * (x[0] - c) * (1 / (max_b * sigmoid(args[1]))))) - 0.5) + 1;
 }
 
+// The same function for a whole batch of x at once, which is a logistic function:
+// f(x) = (2 - a) + 2(a - 1) / [1+e^(-(x-c)/(max_b x sigmoid(b)))]
+void time_complexity::convergence_function(int length, const double x[], const long double* args, int c, long double max_b, double out[], simd_level_t simd){
+    logistic(length, x, 2 - args[0], 2 * (args[0] - 1), c, 1 / (max_b * sigmoid(args[1])), out, simd);
+}
+
 // A simple sigmoid function that takes in an x and an a
 // f(x) = a / (1 + e^{-x})
 long double time_complexity::sigmoid(long double x){
     return 1 / (1 + exp(-1 * x));
 }
 
-// find an appropriate given the total_budget and computational_budget
+// Finds where one call to func reaches the computation_budget: n doubles from 2 until a
+// probe runs over the budget, then the last doubling is bisected down to 1/BISECTION_RESOLUTION
+// of n. Every probe that ran within the budget is kept in probes, and becomes a sample of
+// the table once it is inside of the interval (all of them when the table restarts from 1).
+// Returns the largest probed n within the budget as the start, and the smallest one over the
+// budget as the jump.
 tuple<int, int, int> time_complexity::find_interval(function<void(int)> func){
     int jmp;
     int max_jmp = 10000000;
     int jmp_factor = 2;
     jmp = jmp_factor;
-    int ppbf, ppaf;
+    long long ppbf, ppaf;
 
     ppbf = get_time;
 
     while(jmp <= max_jmp){
-        // run for the first interval.
-        int first_interval = run_func_with_budget(func, jmp, computation_budget);
+        // gallop: run for the first interval.
+        int first_interval = run_probe(func, jmp);
+
+        if(first_interval == SAMPLE_OVER_BUDGET){
+            // bisect: lo always runs within the budget and hi over it.
+            int lo = jmp / jmp_factor;
+            int hi = jmp;
+            while(hi - lo > max(1, lo / BISECTION_RESOLUTION)){
+                int mid = lo + (hi - lo) / 2;
+                if(run_probe(func, mid) == SAMPLE_IN_BUDGET) lo = mid;
+                else hi = mid;
+            }
 
-        if(first_interval == 1){
             ppaf = get_time;
             preprocessing_time = ppaf - ppbf;
-            return {jmp/jmp_factor, INT_MAX, jmp};
+            return {lo, INT_MAX, hi};
         }
-            //return {1, jmp/jmp_factor * total_budget / computation_budget * 10, jmp/jmp_factor};
 
         jmp *= jmp_factor;
     }
@@ -408,8 +1873,19 @@ time_complexity::time_complexity(int millisecond_total_budget, int millisecond_c
     this->show_gradient = false;
     this->show_possible_big_o = true;
 
-    // Create pipe
+    // 1000x the resolution of the clock we time with.
+    struct timespec resolution;
+    clock_getres(CLOCK_REALTIME, &resolution);
+    this->calibration_target = 1000 * ((long long) resolution.tv_sec * 1000000000 + resolution.tv_nsec);
+    if(this->calibration_target < MIN_CALIBRATION_TARGET) this->calibration_target = MIN_CALIBRATION_TARGET;
+    this->calibration_iterations = 1;
+
+    // every test lays its samples out in the same memory.
+    samples.reserve(DATA_CAP, fs.size());
+
+    // Create pipe (the read end does not block so that a crashed child cannot hang us)
     assert(pipe(fd) != -1);
+    fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL) | O_NONBLOCK);
 }
 
 // we need to find the intervals for the omega_test function.
@@ -421,7 +1897,24 @@ bool time_complexity::compute_complexity(string name, function<void(int)> func,
         printf("Time complexity guess must start with either \'O\' or \'T\', representing Big-O and Big-Theta tests, respectively.\n");
     }
     
+    start_measuring(func);
+
+    // the samples are appended to the result file of the test as they arrive.
+    if(save_data && save_binary){
+        string dir = data_directory + "/" + name;
+        mkdir(data_directory.c_str(), 0744);
+        mkdir(dir.c_str(), 0744);
+        result_run_t settings = {0, name, 0, total_budget, computation_budget, trials, calibrate, cost_metric, space_metric, fit_solver, {}, {}};
+        results = new result_writer(dir + "/results.tcr", settings);
+        if(!results->usable()){
+            if(verbose) cout << "Cannot write to " << dir << "/results.tcr, the samples of this test are not saved.\n";
+            delete results;
+            results = nullptr;
+        }
+    }
+
     int st, end, jmp;
+    probes.clear();
     if(this->auto_interval){
         tie(st, end, jmp) = find_interval(func);
     } else {
@@ -429,31 +1922,147 @@ bool time_complexity::compute_complexity(string name, function<void(int)> func,
         tie(st, end, jmp) = tuple<int,int,int>{1, INT_MAX, 1}; // a hard cap on the # of tests.
     }
 
-    char s[40];
+    char s[80];
     sprintf(s, "Interval: [%d, %d), Jump = %d", st, end, jmp);
     if(show_interval) cout << (string) s << "\n";
 
     // Generate table
     complexity_table_generator(func, st, end, jmp);
+    stop_measuring();
+    delete results;
+    results = nullptr;
 
-    string guess_name = "NOT FOUND";
+    return conclude(name, expected_complexity);
+}
+
+// Re-runs the analysis of a stored run on its raw samples. The samples are combined and fitted
+// exactly as if they had just been collected, but with the current settings. The fits are
+// saved as JSON files (with save_data and save_json), and not to the result file.
+bool time_complexity::analyze(string path, int run, string expected_complexity){
+    result_reader reader(path);
+    if(!reader.usable() || reader.runs.empty()){
+        printf("Cannot read the runs of %s.\n", path.c_str());
+        return false;
+    }
+    if(run < 0) run += reader.runs.size();
+    if(run < 0 || run >= reader.runs.size()){
+        printf("%s has %lu runs, there is no run %d.\n", path.c_str(), reader.runs.size(), run);
+        return false;
+    }
+    const result_run_t& stored = reader.runs[run];
+    this->current_test_name = stored.name;
+
+    init();
+    preprocessing_time = 0;
+    for(int i = 0; i < stored.samples.size(); ++i){
+        for(int row = 0; row < stored.samples[i].rows; ++row) dds.push_back(stored.samples[i].sample(row));
+    }
+    stable_sort(dds.begin(), dds.end(), [](const dd_t& a, const dd_t& b) -> bool {return a.n < b.n;});
+    reduce_trials();
+    if(dds.size() < MIN_TABLE_VALUES){
+        printf("Run %d of %s has too few samples (%lu).\n", run, path.c_str(), dds.size());
+        return false;
+    }
+
+    // the interval of the test is stored with its fits.
+    int st = stored.fits.empty() ? dds[0].n : stored.fits[0].st;
+    int end = stored.fits.empty() ? INT_MAX : stored.fits[0].end;
+    fit_samples(st, end);
+
+    return conclude(stored.name, expected_complexity);
+}
+
+// Prints the functions that fit and the verdict of the test that was just fitted.
+bool time_complexity::conclude(string name, string expected_complexity){
     if(show_possible_big_o) cout << "Possible Big O functions: \n";
     for(int i = 0; i < stats.size(); ++i){
         if(show_possible_big_o) printf("  - %s : (a = %.5Lf, error = %.5Lf) \n", stats[i].name.c_str(), stats[i].a, stats[i].error);
+    }
+    string guess_name = best_guess(stats);
 
-        // We guess the last function that doesn't converge to zero (there is likely only one function like this).
-        if(stats[i].a >= zero){
-            guess_name = stats[i].name;
-            guess_name.erase(guess_name.begin());
-            guess_name = "\u0398" + guess_name;
-        }
+    if(measure_space) print_guess("Space", space_stats);
+
+    if(per_operation && dds.size() > 0){
+        print_guess("Amortized", amortized_stats);
+        print_guess("Worst operation", worst_stats);
+        const dd_t& largest = dds[dds.size() - 1];
+        printf("Per operation at n = %d: %.1Lf ns amortized, %.1Lf ns worst\n", largest.n, cost_of(largest, AMORTIZED_TIME), cost_of(largest, WORST_OPERATION));
+    }
+
+    return report(name, "n = " + to_string(dds.size()), guess_name, stats, expected_complexity);
+}
+
+// Tests func(n, m) as a function of the two variables n and m.
+bool time_complexity::compute_complexity(string name, function<void(int, int)> func, string expected_complexity){
+    return compute_complexity(name, [func](const vector<int>& x) {func(x[0], x[1]);}, {"n", "m"}, expected_complexity);
+}
+
+// Samples func over a grid of the variables (see collect_grid), and fits products and sums
+// of the complexity functions of every variable to the samples (see fit_sweep). The
+// samples are measured like those of a unary function (with the index of the point as
+// n, see collect_grid), but they are not saved, and the sweep always fits in closed form with one trial per point.
+bool time_complexity::compute_complexity(string name, function<void(const vector<int>&)> func, vector<string> variables, string expected_complexity){
+    this->current_test_name = name;
+    int dimensions = variables.size();
+    if(dimensions < 1 || dimensions > MAX_VARIABLES){
+        printf("A sweep takes between 1 and %d variables, not %d.\n", MAX_VARIABLES, dimensions);
+        return false;
+    }
+
+    if(expected_complexity.size() != 0 && expected_complexity[0] != 'T' && expected_complexity[0] != 'O'){
+        printf("Invalid time complexity guess: %s\n", expected_complexity.c_str());
+        printf("Time complexity guess must start with either \'O\' or \'T\', representing Big-O and Big-Theta tests, respectively.\n");
+    }
+
+    // the measuring process decodes the index of every sample into the point it stands for.
+    vector<int> point(dimensions);
+    function<void(int)> point_func = [func, point](int index) mutable {
+        for(int d = 0; d < point.size(); ++d) point[d] = level_value((index >> (d * LEVEL_BITS)) & ((1 << LEVEL_BITS) - 1));
+        func(point);
+    };
+
+    start_measuring(point_func);
+    init();
+    preprocessing_time = 0; // the probes of the grid are part of the sweep.
+    collect_grid(point_func, dimensions);
+    stop_measuring();
+
+    if(verbose) cout << "\n\nTotal time: " << (double) total_time / 1000 << "\n\n";
+    if(dds.size() < MIN_TABLE_VALUES){
+        cout << ("Increase total budget.\n. Too few values collected.\n");
+        return false;
     }
 
-    if(guess_name == "NOT FOUND" && stats.size() != 0){
-        guess_name = stats[0].name; // take the lowest big O.
+    int num_threads = fit_threads > 0 ? fit_threads : thread::hardware_concurrency();
+    fitters = new thread_pool(num_threads > 0 ? num_threads : 1);
+    ostringstream out;
+    string guess_name = fit_sweep(variables, stats, out);
+    delete fitters;
+    fitters = nullptr;
+
+    if(show_possible_big_o) cout << "Possible Big O functions: \n";
+    for(int i = 0; i < stats.size(); ++i){
+        if(show_possible_big_o) printf("  - %s : (a = %.5Lf, error = %.5Lf) \n", stats[i].name.c_str(), stats[i].a, stats[i].error);
+    }
+    cout << out.str();
+
+    // the size of the grid, as the number of values of every variable (the index of a point is no size).
+    string size;
+    for(int d = 0; d < dimensions; ++d){
+        set<int> levels;
+        for(int j = 0; j < dds.size(); ++j) levels.insert((dds[j].n >> (d * LEVEL_BITS)) & ((1 << LEVEL_BITS) - 1));
+        size += (d > 0 ? " x " : "") + to_string(levels.size());
     }
+    size += " grid, " + to_string(dds.size()) + " points";
 
-    sprintf(s, "[%.3fs, n = %lu]", (double) (total_time + preprocessing_time) / 1000000 / 1000, dds.size());
+    return report(name, size, guess_name, stats, expected_complexity);
+}
+
+// Prints the verdict of a test with the size of its samples (and whether it matches the expected
+// complexity, when there is one), and returns whether it does.
+bool time_complexity::report(string name, string size, string guess_name, const vector<convergence_data_t>& found, string expected_complexity){
+    char s[80];
+    snprintf(s, sizeof(s), "[%.3fs, %s]", (double) (total_time + preprocessing_time) / 1000000 / 1000, size.c_str());
 
     assert(expected_complexity == "" || expected_complexity.length() > 0);
 
@@ -466,8 +2075,8 @@ bool time_complexity::compute_complexity(string name, function<void(int)> func,
             return expected_complexity == guess_name;
         }else if(expected_complexity[0] == 'O'){
             bool bigO = false;
-            for(int i = 0; i < stats.size(); ++i){
-                if(expected_complexity == stats[i].name){
+            for(int i = 0; i < found.size(); ++i){
+                if(expected_complexity == found[i].name){
                     bigO = true;
                     break;
                 }
@@ -483,70 +2092,169 @@ bool time_complexity::compute_complexity(string name, function<void(int)> func,
     return (expected_complexity == "" || expected_complexity == guess_name);
 }
 
+// Measures func with a worker pool or on a measurement thread, when either is enabled.
+void time_complexity::start_measuring(function<void(int)> func){
+    if(use_worker_pool){
+        pool = new worker_pool([func](sample_request_t request) -> dd_t {return measure_sample(func, request);}, worker_pool_size);
+    }
+
+    if(in_process){
+        runner = new in_process_runner([func](sample_request_t request) -> dd_t {return measure_sample(func, request);});
+    }
+}
+
+void time_complexity::stop_measuring(){
+    delete pool;
+    pool = nullptr;
+    delete runner;
+    runner = nullptr;
+}
+
+long long time_complexity::get_unused_budget(){
+    return unused_budget / 1000000;
+}
 
 // ------------------------ OTHER FUNCTIONS ------------------------
 
+// The bases of the default functions. The polynomial and exponential functions stop at
+// the n where they would overflow an int.
+struct constant_basis{
+    long double operator()(int n, int st, int end) const {return 1;}
+};
+
+struct logarithmic_basis{
+    long double operator()(int n, int st, int end) const {return log(n);}
+};
+
+struct sqrt_basis{
+    long double operator()(int n, int st, int end) const {return pow(n, 0.5);}
+};
+
+struct linear_basis{
+    long double operator()(int n, int st, int end) const {return n;}
+};
+
+struct linearxlogarithmic_basis{
+    long double operator()(int n, int st, int end) const {return n != 1 ? n * log(n) : 1;}
+};
+
+struct quadratic_basis{
+    long double operator()(int n, int st, int end) const {return n <= pow(INT_MAX, 0.5) ? n * n: INFINITY;} // normalized n^2 function
+};
+
+struct cubic_basis{
+    long double operator()(int n, int st, int end) const {return n <= pow(INT_MAX, 0.332) ? n * n * n: INFINITY;}
+};
+
+struct exponentialxhalf_basis{
+    long double operator()(int n, int st, int end) const {return n <= log(INT_MAX)/log(1.51) ? pow(1.5, n) : INFINITY;}
+};
+
+struct exponentialx2_basis{
+    long double operator()(int n, int st, int end) const {return (long long) n <= log(INT_MAX)/log(2.01) ? pow(2, n) : INFINITY;}
+};
+
+struct super_exponential_basis{
+    long double operator()(int n, int st, int end) const {
+        if(st > 4) n /= st;
+        return (long double) n <= 8 ? pow(n, n)/pow(st, st) : INFINITY;
+    }
+};
+
 vector<function_type_t> default_functions() {
     vector<function_type_t> functions;
 
-    function_type_t constant;
-    constant.name = "O(1)";
-    constant.function_base = [](int n, int st, int end)->long double {return 1;};
-    functions.push_back(constant); 
-
-    function_type_t logarithmic;
-    logarithmic.name = "O(log n)";
-    logarithmic.function_base = [](int n, int st, int end)->long double {return log(n);};
-    functions.push_back(logarithmic); 
-
-    function_type_t sqrt;
-    sqrt.name = "O(sqrt(n))";
-    sqrt.function_base = [](int n, int st, int end)->long double {return pow(n, 0.5);};
-    functions.push_back(sqrt); 
-
-    function_type_t linear;
-    linear.name = "O(n)";
-    linear.function_base = [](int n, int st, int end)->long double {return n;};
-    functions.push_back(linear); 
-
-    function_type_t linearxlogarithmic;
-    linearxlogarithmic.name = "O(n log n)";
-    linearxlogarithmic.function_base = [](int n, int st, int end)->long double {return n != 1 ? n * log(n) : 1;};
-    functions.push_back(linearxlogarithmic); 
-
-    function_type_t quadratic;
-    quadratic.name = "O(n^2)";
-    quadratic.function_base = [](int n, int st, int end)->long double {return n <= pow(INT_MAX, 0.5) ? n * n: INFINITY;}; // normalized n^2 function
-    functions.push_back(quadratic); 
-
-    function_type_t cubic;
-    cubic.name = "O(n^3)";
-    cubic.function_base = [](int n, int st, int end)->long double {
-        return n <= pow(INT_MAX, 0.332) ? n * n * n: INFINITY;
-    };
-    functions.push_back(cubic); 
+    functions.push_back(basis_function<constant_basis>("O(1)"));
+    functions.push_back(basis_function<logarithmic_basis>("O(log n)"));
+    functions.push_back(basis_function<sqrt_basis>("O(sqrt(n))"));
+    functions.push_back(basis_function<linear_basis>("O(n)"));
+    functions.push_back(basis_function<linearxlogarithmic_basis>("O(n log n)"));
+    functions.push_back(basis_function<quadratic_basis>("O(n^2)"));
+    functions.push_back(basis_function<cubic_basis>("O(n^3)"));
+    functions.push_back(basis_function<exponentialxhalf_basis>("O(1.5^n)"));
+    functions.push_back(basis_function<exponentialx2_basis>("O(2^n)"));
+    functions.push_back(basis_function<super_exponential_basis>("O(n^n)"));
 
-    function_type_t exponentialxhalf;
-    exponentialxhalf.name = "O(1.5^n)";
-    exponentialxhalf.function_base = [](int n, int st, int end)->long double {
-        return n <= log(INT_MAX)/log(1.51) ? pow(1.5, n) : INFINITY;
-    };
-    functions.push_back(exponentialxhalf); 
+    return functions;
+}
 
-    function_type_t exponentialx2;
-    exponentialx2.name = "O(2^n)";
-    exponentialx2.function_base = [](int n, int st, int end)->long double {
-        return (long long) n <= log(INT_MAX)/log(2.01) ? pow(2, n) : INFINITY;
+// Rounds an exponent to a multiple of FAMILY_RESOLUTION, and writes it the way the default
+// functions do (1.5 rather than 1.50).
+static long double round_exponent(long double exponent){
+    return roundl(exponent / FAMILY_RESOLUTION) * FAMILY_RESOLUTION;
+}
+
+static bool same_exponent(long double a, long double b){
+    return fabsl(a - b) < FAMILY_RESOLUTION / 2;
+}
+
+static string exponent_string(long double exponent){
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%g", (double) exponent);
+    return buf;
+}
+
+// n^a log^b n, named like the default functions ("n log n", "n^2", "log^2 n", ...).
+static function_type_t polylogarithmic(long double a, long double b){
+    if(same_exponent(a, 0)) a = 0;
+    if(same_exponent(b, 0)) b = 0;
+    string n_part = a == 0 ? "" : (same_exponent(a, 1) ? "n" : (same_exponent(a, 0.5) ? "sqrt(n)" : "n^" + exponent_string(a)));
+    string log_part = b == 0 ? "" : (same_exponent(b, 1) ? "log n" : "log^" + exponent_string(b) + " n");
+    string name = n_part + (n_part != "" && log_part != "" ? " " : "") + log_part;
+
+    function_type_t f;
+    f.name = "O(" + (name == "" ? "1" : name) + ")";
+    f.function_base = [a, b](int n, int st, int end) -> long double {return powl(n, a) * (b == 0 ? 1 : powl(log(n), b));};
+    f.batch_base = [a, b](int length, const double* n, int st, int end, long double* out) {
+        for(int i = 0; i < length; ++i) out[i] = powl(n[i], a) * (b == 0 ? 1 : powl(log(n[i]), b));
     };
-    functions.push_back(exponentialx2); 
+    return f;
+}
 
-    function_type_t super_exponential;
-    super_exponential.name = "O(n^n)";
-    super_exponential.function_base = [](int n, int st, int end)->long double {
-        if(st > 4) n /= st;
-        return (long double) n <= 8 ? pow(n, n)/pow(st, st) : INFINITY;
+vector<function_family_t> parametric_families(){
+    vector<function_family_t> families;
+
+    function_family_t polynomial;
+    polynomial.name = "n^k";
+    polynomial.num_exponents = 1;
+    polynomial.regressors = [](int n, long double* out) {out[0] = log(n);};
+    polynomial.resolve = [](const long double* exponents) -> function_type_t {return polylogarithmic(round_exponent(exponents[0]), 0);};
+    families.push_back(polynomial);
+
+    function_family_t polylog;
+    polylog.name = "n^a log^b n";
+    polylog.num_exponents = 2;
+    polylog.regressors = [](int n, long double* out) {
+        out[0] = log(n);
+        out[1] = log(log(n)); // not finite for n = 1, which is left out of the fit.
+    };
+    // over the n of a test, log n and log log n hardly differ in shape, so noise can make up
+    // powers of log n that no algorithm has (log^-4 n, log^20 n). Those are left out.
+    polylog.resolve = [](const long double* exponents) -> function_type_t {
+        long double b = round_exponent(exponents[1]);
+        if(b < 0 || b > FAMILY_MAX_LOG_POWER) return function_type_t();
+        return polylogarithmic(round_exponent(exponents[0]), b);
     };
-    functions.push_back(super_exponential); 
+    families.push_back(polylog);
+
+    // log(c^n) = n log(c)
+    function_family_t exponential;
+    exponential.name = "c^n";
+    exponential.num_exponents = 1;
+    exponential.regressors = [](int n, long double* out) {out[0] = n;};
+    exponential.resolve = [](const long double* exponents) -> function_type_t {
+        long double c = round_exponent(exp(exponents[0]));
+        if(c < 1 + FAMILY_RESOLUTION / 2) return polylogarithmic(0, 0);
+
+        function_type_t f;
+        f.name = "O(" + exponent_string(c) + "^n)";
+        f.function_base = [c](int n, int st, int end) -> long double {return powl(c, n);};
+        f.batch_base = [c](int length, const double* n, int st, int end, long double* out) {
+            for(int i = 0; i < length; ++i) out[i] = powl(c, n[i]);
+        };
+        return f;
+    };
+    families.push_back(exponential);
 
-    return functions;
-}
\ No newline at end of file
+    return families;
+}
@@ -13,32 +13,111 @@
 #include <unistd.h>
 #include <signal.h>
 #include <tuple>
+#include "supervisor/supervisor.h"
+#include "perf_counters/perf_counters.h"
+#include "memory_usage/memory_usage.h"
+#include "operation_timer/operation_timer.h"
+#include "gradient_descent/gradient_descent.h"
+#include "sample_table/sample_table.h"
+#include "least_squares/least_squares.h"
 
 using namespace std;
 
 typedef struct functiontype{
     string name;
     function<long double(int, int, int)> function_base;
+    // Optional: f for a whole column of n at once, batch_base(length, n, st, end, out). The
+    // fits call it (when it is set) instead of function_base for every n (see basis_function).
+    function<void(int, const double*, int, int, long double*)> batch_base;
 } function_type_t;
 
+// A complexity function whose f(n) is evaluated by Basis, a default-constructible functor with
+//     long double operator()(int n, int st, int end) const
+// (which may be constexpr). The loop over a column of n calls it directly, so it is inlined
+// instead of going through a std::function for every n.
+template<typename Basis>
+function_type_t basis_function(string name){
+    function_type_t f;
+    f.name = name;
+    f.function_base = [](int n, int st, int end) -> long double {return Basis()(n, st, end);};
+    f.batch_base = [](int length, const double* n, int st, int end, long double* out) {
+        Basis basis;
+        for(int i = 0; i < length; ++i) out[i] = basis((int) n[i], st, end);
+    };
+    return f;
+}
+
+// A family of complexity functions with exponents that are fitted to the samples, such as
+// n^k. log f(n) = sum(exponents[k] * regressors[k]), so the exponents are fitted to the
+// logarithm of the cost in closed form, and resolve turns them into one complexity function
+// (rounding them to values that are worth naming), or into a function without a name when
+// the exponents are not plausible.
+typedef struct function_family{
+    string name;
+    int num_exponents;
+    function<void(int, long double*)> regressors;
+    function<function_type_t(const long double*)> resolve;
+} function_family_t;
+
 typedef struct duration_data{
     int n;
-    long long duration;
+    long double duration; // nanoseconds per call to func(n)
+    long long iterations; // how many calls were timed together
+    long double counters[NUM_PERF_COUNTERS]; // hardware events per call (see perf_counters), -1 when not counted
+    long double heap_bytes;  // the most heap memory held at once during the calls (see memory_usage), -1 when not counted
+    long double allocations; // heap allocations per call, -1 when not counted
+    long double rss_bytes;   // how much the peak resident set size grew over the sample, -1 when not counted
+    long double operations;      // operations per call (see operation_timer), -1 when not timed
+    long double worst_operation; // the longest single operation over the sample (ns), -1 when not timed
+    // filled in once the trials of an n are combined (see time_complexity::trials):
+    int trials;           // how many trials were kept
+    long double minimum;  // the smallest cost per call over all trials
+    long double mad;      // the median absolute deviation of the cost over all trials
+    long double variance; // the variance of the cost over the kept trials (0 for one trial)
 } dd_t;
 
-typedef struct ratio_data{
+// The cost of a sample that we fit the complexity functions against.
+typedef enum cost_metric{
+    WALL_TIME,
+    INSTRUCTIONS,  // these follow the order of the perf counters.
+    CYCLES,
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    AMORTIZED_TIME,  // these are per-operation metrics (see time_complexity::per_operation).
+    WORST_OPERATION,
+    HEAP_BYTES,    // these are space metrics (see time_complexity::space_metric).
+    ALLOCATIONS,
+    RSS_BYTES
+} cost_metric_t;
+
+// How the complexity functions are fitted to the samples.
+typedef enum fit_solver{
+    GRADIENT_DESCENT_FIT,     // fit a converging function to the ratio of the cost and f(n) iteratively
+    LEAST_SQUARES_FIT,        // fit c0 + c1 f(n) to the cost in closed form
+    LEVENBERG_MARQUARDT_FIT   // fit the same converging function as GRADIENT_DESCENT_FIT with damped least squares
+} fit_solver_t;
+
+// What the measuring process is asked to do for one sample.
+typedef struct sample_request{
     int n;
-    long double ratio;
-} rd_t;
+    long long iterations; // the number of back-to-back calls to start calibrating from
+    long long target;     // grow iterations until the batch runs this long (ns), 0 to time one batch as is
+    bool count_events;    // read the hardware performance counters around the batch
+    bool track_memory;    // record the heap usage and peak resident set size of the calls
+    bool time_operations; // time every operation that the calls mark (see operation_timer)
+} sample_request_t;
 
 typedef struct convergence_data{
     string name;
     long double a;
     long double error;
+    long double score; // how well a closed-form fit explains the samples, lower is better
 } convergence_data_t;
 
 // f(x) = 2(a - 1)(1 / [1+e^(-(x-c)/(d x sigmoid(b)))] - 0.5) + 1
 const string FUNCTION_STR = "2(a - 1)(1 / [1+e^(-(x-c)/(d x sigmoid(b)))] - 0.5) + 1";
+// what the guesses of the closed-form fit describe (the cost itself rather than the ratio).
+const string LEAST_SQUARES_STR = "a + b f(n)";
 typedef struct guess_collection {
     long double a;
     long double b;
@@ -48,6 +127,14 @@ typedef struct guess_collection {
 } guess_collection_t;
 
 vector<function_type_t> default_functions();
+// n^k, n^a log^b n and c^n.
+vector<function_family_t> parametric_families();
+
+class worker_pool;
+class in_process_runner;
+class thread_pool;
+class result_writer;
+typedef struct result_fit result_fit_t;
 
 class time_complexity{
 private:
@@ -57,26 +144,85 @@ private:
     long long preprocessing_time;
     vector<function_type_t> fs;
     vector<dd_t> dds;
-    vector<vector<long double>> ratios;
-    vector<vector<long double>> dratios;
+    vector<dd_t> probes;
+    sample_table samples;       // the samples of the time fit
+    sample_table space_samples; // the samples of the space fit
+    sample_table amortized_samples; // the samples of the per-operation fits
+    sample_table worst_samples;
+    // the closed-form fits of every function as the samples arrive (see observe):
+    vector<online_fit_t> online_fits;
+    vector<bool> online_finite;
+    vector<bool> online_constant;
+    vector<long double> online_first_x;
+    int online_count;
+    long double online_sum_of_weights;
+    int largest_observed;
+    int confident_streak;
+    bool confident;
+    long long unused_budget;
     vector<long double> medians;
     vector<double> means;
     vector<convergence_data_t> stats;
+    vector<convergence_data_t> space_stats;
+    vector<convergence_data_t> amortized_stats;
+    vector<convergence_data_t> worst_stats;
     string current_test_name;
     int fd[2];
+    long long calibration_iterations;
+    worker_pool* pool{nullptr};
+    in_process_runner* runner{nullptr};
+    thread_pool* fitters{nullptr};
+    result_writer* results{nullptr};
+    supervisor watcher;
     void init();
-    int run_func_with_budget(function<void(int)> func, int n, int budget);
+    int run_probe(function<void(int)> func, int n);
+    void update_calibration(const dd_t& sample);
+    void keep(const dd_t& sample);
+    bool observe(const dd_t& sample);
+    long double cost_of(const dd_t& sample, cost_metric_t metric);
+    long double cost_of(const dd_t& sample);
+    sample_request_t request_for(int n);
+    int run_sample(function<void(int)> func, int n, long long budget, dd_t& result);
+    int run_sample_in_child(function<void(int)> func, sample_request_t request, long long budget, dd_t& result);
+    void collect_sequentially(function<void(int)> func, int st, int end, int jmp);
+    void collect_in_parallel(function<void(int)> func, int st, int end, int jmp);
+    void collect_adaptively(function<void(int)> func, int st, int end);
+    vector<int> rank_functions(vector<long double>& scales);
+    void reduce_trials();
     void complexity_table_generator(function<void(int)> func, int st, int end, int jmp);
+    void fit_samples(int st, int end);
+    bool conclude(string name, string expected_complexity);
+    void start_measuring(function<void(int)> func);
+    void stop_measuring();
+    int run_grid_sample(function<void(int)> func, const vector<int>& levels);
+    void collect_grid(function<void(int)> func, int dimensions);
+    string fit_sweep(const vector<string>& variables, vector<convergence_data_t>& found, ostream& out);
+    bool report(string name, string size, string guess_name, const vector<convergence_data_t>& found, string expected_complexity);
+    void fit_costs(int st, int end, cost_metric_t metric, sample_table& table, vector<convergence_data_t>& found, string name, 
+        result_fit_t& fit, ostream& out);
+    void fit_families(sample_table& table, vector<function_type_t>& candidates, vector<int>& parameters, ostream& out);
+    string best_guess(const vector<convergence_data_t>& found);
+    void print_guess(string what, const vector<convergence_data_t>& found);
+    void fit_least_squares(const vector<function_type_t>& candidates, const vector<int>& parameters, sample_table& table, 
+        vector<convergence_data_t>& found, ostream& out);
     static long double convergence_function(const long double* x, long double* args, int c, long double max_b);
+    static void convergence_function(int length, const double x[], const long double* args, int c, long double max_b, double out[], simd_level_t simd);
     static long double sigmoid(long double x);
     tuple<int, int, int> find_interval(function<void(int)> func);
-    void save_to_file(vector<rd_t> vals[], vector<guess_collection_t> guesses);
+    void describe_fit(string name, cost_metric_t metric, int st, int end, const vector<function_type_t>& candidates, sample_table& table, 
+        const vector<convergence_data_t>& found, result_fit_t& fit);
+    void save_to_file(const result_fit_t& fit);
 
 public:
     // Where we store the table log information:
     string data_directory{"./data"};
-    // Automatically save data to the data directory:
+    // Automatically save data to the data directory (the tests of one variable only):
     bool save_data{true};
+    // How the data is saved: a JSON file per run (and fit), and the raw samples and fits of
+    // every run appended to data_directory/<test name>/results.tcr while the test runs (see
+    // result_file.h, which also reads it back and exports the JSON):
+    bool save_json{true};
+    bool save_binary{true};
    // Auto-Interval capabilities:
     bool auto_interval;
     // Different levels of verbose-ness:
@@ -84,12 +230,73 @@ public:
     bool verbose;
     bool show_gradient;
     bool show_possible_big_o;
+    // Measure with a pool of pre-forked workers instead of forking once per sample:
+    bool use_worker_pool{false};
+    int worker_pool_size{2};
+    // Call the function on a measurement thread of this process (with a watchdog enforcing
+    // the budget), falling back to a separate process once a sample overruns or crashes:
+    bool in_process{false};
+    // Run func(n) as many times back to back as it takes for a sample to last at least
+    // calibration_target nanoseconds (1000x the clock resolution by default) and record
+    // the cost per call:
+    bool calibrate{false};
+    long long calibration_target;
+    // Fit against a hardware performance counter instead of wall-clock time (Linux only,
+    // falls back to wall-clock time when the counters cannot be opened):
+    cost_metric_t cost_metric{WALL_TIME};
+    // The cores samples run on. With more than one core, samples for different n run
+    // concurrently (one per core) in separate processes and are merged in n order:
+    vector<int> cpus;
+    // Samples collected per n. Trials far from the median (in MADs) are rejected, the
+    // median of the rest is used, and n with noisier trials weigh less in the fit:
+    int trials{1};
+    // Sample geometrically spaced n, each where the two best fitting complexity functions
+    // disagree the most within the remaining budget, and stop once the best fit is stable
+    // (instead of sampling every jmp-th n until the budget runs out):
+    bool adaptive_schedule{false};
+    // Also guess the space complexity, by fitting the same functions against space_metric
+    // (the peak heap bytes by default, falling back to the peak resident set size):
+    bool measure_space{false};
+    cost_metric_t space_metric{HEAP_BYTES};
+    // The function performs n operations and marks the end of every one with operation_done():
+    // also guess how the amortized cost of an operation and the worst single operation grow:
+    bool per_operation{false};
+    // Fit the samples as they arrive, and stop sampling once the closed-form fits favour one
+    // function with at least this confidence (the rest of the budget is left unused):
+    bool early_stop{false};
+    long double confidence{0.99};
+    // Families of functions whose exponents are fitted to the samples (see parametric_families).
+    // Every family adds the one function that fits best to the functions of the test:
+    vector<function_family_t> families;
+    // How the complexity functions are fitted (see fit_solver_t):
+    fit_solver_t fit_solver{LEAST_SQUARES_FIT};
+    // The instruction set that the gradient descent fit evaluates its loss with:
+    simd_level_t simd{SIMD_AUTO};
+    // Fit the complexity functions (and the time and space fits) on this many threads once
+    // sampling is done, 0 for one per core. The verdict and output do not depend on it. A test
+    // is fitted before the next one samples, so fits never run during a measurement:
+    int fit_threads{0};
     // default maximum error to indicate convergence.
     long double convergence_error = 0.01; 
     // if a ratio converges to a value below this, we will assume it converges to 0.
     long double zero = 0.3; 
     time_complexity(int millisecond_total_budget, int millisecond_computation_budget=1, vector<function_type_t> fs=default_functions());
     bool compute_complexity(string name, function<void(int)> func, string expected_complexity="");
+    // Tests func(n, m) over a grid of n and m (see the compute_complexity for any number of variables):
+    bool compute_complexity(string name, function<void(int, int)> func, string expected_complexity="");
+    // Tests a function of several variables, func(x) with one value in x for every name in
+    // variables, over a grid of x. The default functions of every variable are combined into
+    // products (such as O(m log n)) and sums (such as O(n + m)), and the verdict is the one
+    // that explains the samples best. Sweeps are not saved (see save_data), so they cannot be
+    // analysed again:
+    bool compute_complexity(string name, function<void(const vector<int>&)> func, vector<string> variables, string expected_complexity="");
+    // Analyses a run that was saved to a result file (see save_binary) again, on its raw samples
+    // and with the current settings (the functions, families, fit_solver, convergence_error, zero,
+    // metrics and so on), without running the function again. run counts from 0, or back
+    // from the last run (-1) when it is negative:
+    bool analyze(string path, int run=-1, string expected_complexity="");
+    // The milliseconds of the total budget that the last test left unused (see early_stop):
+    long long get_unused_budget();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,23 @@
+#include "time_complexity_slim.h"
+#include "../time_complexity.h"
+
+slim_time_complexity::slim_time_complexity(int millisecond_total_budget, int millisecond_computation_budget){
+    tc = new time_complexity(millisecond_total_budget, millisecond_computation_budget);
+}
+
+slim_time_complexity::~slim_time_complexity(){
+    delete tc;
+}
+
+bool slim_time_complexity::compute_complexity(const char* name, void (*func)(int), const char* expected_complexity){
+    tc->auto_interval = auto_interval;
+    tc->calibrate = calibrate;
+    tc->trials = trials;
+    tc->use_worker_pool = use_worker_pool;
+    tc->in_process = in_process;
+    tc->adaptive_schedule = adaptive_schedule;
+    tc->early_stop = early_stop;
+    tc->measure_space = measure_space;
+    tc->save_data = save_data;
+    return tc->compute_complexity(name, func, expected_complexity);
+}
@@ -0,0 +1,37 @@
+#ifndef TIME_COMPLEXITY_SLIM
+#define TIME_COMPLEXITY_SLIM
+
+// The part of time_complexity that a generated test (see python-scripts/load_program.py)
+// uses, behind a header that includes nothing. A program that only includes this header
+// parses in a fraction of the time it takes to parse time_complexity.h (and the standard
+// headers it drags in), and links against the prebuilt library (make library).
+
+class time_complexity;
+
+class slim_time_complexity{
+    time_complexity* tc;
+
+public:
+    // The settings of time_complexity with the same names (see time_complexity.h). They
+    // are handed to the tester at every call to compute_complexity:
+    bool auto_interval{true};
+    bool calibrate{false};
+    int trials{1};
+    bool use_worker_pool{false};
+    bool in_process{false};
+    bool adaptive_schedule{false};
+    bool early_stop{false};
+    bool measure_space{false};
+    bool save_data{true};
+
+    slim_time_complexity(int millisecond_total_budget, int millisecond_computation_budget=1);
+    ~slim_time_complexity();
+    slim_time_complexity(const slim_time_complexity&) = delete;
+    slim_time_complexity& operator=(const slim_time_complexity&) = delete;
+
+    // Tests func(n) like time_complexity::compute_complexity. A lambda that captures
+    // nothing turns into a function pointer, so func can wrap a call to any function of n.
+    bool compute_complexity(const char* name, void (*func)(int), const char* expected_complexity="");
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "../../time_complexity.h"
+#include "../../result_file/result_file.h"
+#include <string.h>
+#include <stdlib.h>
+
+// Analyses a run saved to a result file again, with other settings than the ones it ran with:
+//     reanalyze.exe RESULT-FILE [OPTIONS]
+// Without options, the last run in the file is fitted with the default settings, against the
+// metric and with the solver it was measured with.
+
+void usage(){
+    printf("Correct usage: reanalyze.exe RESULT-FILE [OPTIONS]\n");
+    printf("  --list                      list the runs in the file\n");
+    printf("  --run K                     the run to analyse (from 0, or -1 for the last one, the default)\n");
+    printf("  --functions \"O(n),O(n^2)\"   only fit these of the default functions\n");
+    printf("  --families                  also fit the parametric families (n^k, n^a log^b n, c^n)\n");
+    printf("  --solver S                  least-squares, gradient-descent or levenberg-marquardt (default: the\n");
+    printf("                              solver of the run)\n");
+    printf("  --metric M                  wall-time, instructions, cycles, cache-misses, branch-misses, amortized-time,\n");
+    printf("                              worst-operation, heap-bytes, allocations or rss-bytes (default: the cost\n");
+    printf("                              metric of the run)\n");
+    printf("  --convergence-error E       the largest error of a function that fits\n");
+    printf("  --zero Z                    ratios that converge below this converge to 0\n");
+    printf("  --expect \"T(n)\"             the expected complexity (see compute_complexity)\n");
+    printf("  --verbose                   print the fit of every function\n");
+    exit(1);
+}
+
+int main(int argc, char** argv){
+    const char* metrics[] = {"wall-time", "instructions", "cycles", "cache-misses", "branch-misses", 
+        "amortized-time", "worst-operation", "heap-bytes", "allocations", "rss-bytes"};
+    const char* solvers[] = {"gradient-descent", "least-squares", "levenberg-marquardt"};
+    if(argc < 2) usage();
+
+    string path = argv[1];
+    int run = -1;
+    string expected = "";
+    bool list = false;
+    bool families = false;
+    bool verbose = false;
+    vector<function_type_t> fs = default_functions();
+    // -1 until they are given, and then the ones of the run.
+    int solver = -1;
+    int metric = -1;
+    long double convergence_error = -1;
+    long double zero = -1;
+
+    for(int i = 2; i < argc; ++i){
+        string option = argv[i];
+        bool has_value = i + 1 < argc;
+        if(option == "--list"){
+            list = true;
+        }else if(option == "--families"){
+            families = true;
+        }else if(option == "--verbose"){
+            verbose = true;
+        }else if(option == "--run" && has_value){
+            run = atoi(argv[++i]);
+        }else if(option == "--expect" && has_value){
+            expected = argv[++i];
+        }else if(option == "--convergence-error" && has_value){
+            convergence_error = strtold(argv[++i], nullptr);
+        }else if(option == "--zero" && has_value){
+            zero = strtold(argv[++i], nullptr);
+        }else if(option == "--functions" && has_value){
+            // the names are separated by commas.
+            string names = string(",") + argv[++i] + ",";
+            vector<function_type_t> chosen;
+            for(int f = 0; f < fs.size(); ++f){
+                if(names.find("," + fs[f].name + ",") != string::npos) chosen.push_back(fs[f]);
+            }
+            if(chosen.empty()) usage();
+            fs = chosen;
+        }else if(option == "--solver" && has_value){
+            string name = argv[++i];
+            int found = -1;
+            for(int k = 0; k < 3; ++k) if(name == solvers[k]) found = k;
+            if(found < 0) usage();
+            solver = found;
+        }else if(option == "--metric" && has_value){
+            string name = argv[++i];
+            int found = -1;
+            for(int k = 0; k < 10; ++k) if(name == metrics[k]) found = k;
+            if(found < 0) usage();
+            metric = found;
+        }else{
+            usage();
+        }
+    }
+
+    if(list){
+        result_reader reader(path);
+        if(!reader.usable()){
+            printf("Cannot read %s.\n", path.c_str());
+            return 1;
+        }
+        for(int i = 0; i < reader.runs.size(); ++i){
+            const result_run_t& stored = reader.runs[i];
+            int count = 0;
+            for(int k = 0; k < stored.samples.size(); ++k) count += stored.samples[k].rows;
+            time_t created = stored.created;
+            char date[80];
+            strftime(date, 80, "%F %T", localtime(&created));
+            printf("%3d  %s  %-30s %6d samples  %.3fs budget  %s\n", i, date, stored.name.c_str(), count, 
+                (double) stored.total_budget / 1000000000, metrics[stored.cost_metric]);
+        }
+        return 0;
+    }
+
+    // the run is fitted the way it was measured, unless the options say otherwise.
+    if(solver < 0 || metric < 0){
+        result_reader reader(path);
+        int index = run < 0 ? run + (int) reader.runs.size() : run;
+        if(reader.usable() && index >= 0 && index < reader.runs.size()){
+            if(solver < 0) solver = reader.runs[index].fit_solver;
+            if(metric < 0) metric = reader.runs[index].cost_metric;
+        }
+    }
+
+    time_complexity tc(1, 1, fs);
+    tc.save_data = false;
+    if(solver >= 0) tc.fit_solver = (fit_solver_t) solver;
+    if(metric >= 0) tc.cost_metric = (cost_metric_t) metric;
+    tc.show_gradient = verbose;
+    if(families) tc.families = parametric_families();
+    if(convergence_error >= 0) tc.convergence_error = convergence_error;
+    if(zero >= 0) tc.zero = zero;
+
+    return tc.analyze(path, run, expected) ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#include "worker_pool.h"
+#include <vector>
+#include <functional>
+#include <cassert>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+#define STOP_WORKER -1
+
+// ----------- PRIVATE -----------
+// Forks the i-th worker. The child never returns from this function.
+void worker_pool::spawn(int i){
+    int request[2];
+    int response[2];
+    assert(pipe(request) != -1);
+    assert(pipe(response) != -1);
+
+    pid_t child_pid = fork();
+    assert(child_pid >= 0);
+
+    if(child_pid == 0){ // child process
+        close(request[1]);
+        close(response[0]);
+
+        // we do not want to hold on to the pipes of our siblings.
+        for(int j = 0; j < workers.size(); ++j){
+            if(j == i || workers[j].pid <= 0) continue;
+            close(workers[j].request_fd);
+            close(workers[j].response_fd);
+        }
+
+        worker_loop(task, request[0], response[1]);
+    }
+
+    close(request[0]);
+    close(response[1]);
+    workers[i] = {child_pid, request[1], response[0]};
+}
+
+// Kills and reaps the i-th worker.
+void worker_pool::retire(int i){
+    if(workers[i].pid <= 0) return;
+
+    kill(workers[i].pid, SIGKILL);
+    waitpid(workers[i].pid, nullptr, 0);
+    close(workers[i].request_fd);
+    close(workers[i].response_fd);
+    workers[i] = {-1, -1, -1};
+}
+
+void worker_pool::worker_loop(function<dd_t(sample_request_t)> task, int request_fd, int response_fd){
+    sample_request_t request;
+
+    while(read(request_fd, &request, sizeof(sample_request_t)) == sizeof(sample_request_t) && request.n != STOP_WORKER){
+        dd_t result = task(request);
+        if(write(response_fd, &result, sizeof(dd_t)) != sizeof(dd_t)) break;
+    }
+
+    // _exit so that we do not flush the stdio buffers we inherited from the parent.
+    _exit(0);
+}
+
+// ----------- PUBLIC -----------
+worker_pool::worker_pool(function<dd_t(sample_request_t)> task, int size){
+    assert(size > 0);
+    this->task = task;
+    this->next = 0;
+    this->workers = vector<worker_t>(size, {-1, -1, -1});
+
+    // a worker that died leaves a broken pipe behind, we want write() to fail instead of being killed.
+    struct sigaction ignore = {};
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &previous_sigpipe);
+
+    for(int i = 0; i < size; ++i){
+        spawn(i);
+    }
+}
+
+worker_pool::~worker_pool(){
+    for(int i = 0; i < workers.size(); ++i){
+        retire(i);
+    }
+    sigaction(SIGPIPE, &previous_sigpipe, nullptr);
+}
+
+// Runs the task for the request on the next worker (round-robin) and waits at most budget
+// nanoseconds for the result. Returns WORKER_IN_BUDGET and fills in result on success,
+// WORKER_OVER_BUDGET or WORKER_CRASHED otherwise (the worker is respawned in both cases).
+int worker_pool::run(sample_request_t request, long long budget, dd_t& result){
+    int i = next;
+    next = (next + 1) % workers.size();
+
+    if(write(workers[i].request_fd, &request, sizeof(sample_request_t)) != sizeof(sample_request_t)){
+        retire(i);
+        spawn(i);
+        return WORKER_CRASHED;
+    }
+
+    // sleep until the worker answers, hangs up or runs out of budget.
+    watcher.watch_fd(i, workers[i].response_fd);
+    bool answered = !watcher.wait(budget).empty();
+    watcher.unwatch(i);
+
+    if(answered && read(workers[i].response_fd, &result, sizeof(dd_t)) == sizeof(dd_t)){
+        return WORKER_IN_BUDGET;
+    }
+
+    retire(i);
+    spawn(i);
+    return answered ? WORKER_CRASHED : WORKER_OVER_BUDGET;
+}
+
+int worker_pool::size(){
+    return workers.size();
+}
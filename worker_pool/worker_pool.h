@@ -0,0 +1,44 @@
+#ifndef WORKER_POOL
+#define WORKER_POOL
+
+#include <vector>
+#include <functional>
+#include <sys/types.h>
+#include <signal.h>
+#include "../time_complexity.h"
+#include "../supervisor/supervisor.h"
+
+using namespace std;
+
+#define WORKER_IN_BUDGET 0
+#define WORKER_OVER_BUDGET 1
+#define WORKER_CRASHED 2
+
+typedef struct worker{
+    pid_t pid;
+    int request_fd;  // parent -> child: the sample_request_t we want measured.
+    int response_fd; // child -> parent: the measured dd_t.
+} worker_t;
+
+// A small set of pre-forked children that receive a sample request over a pipe, run the task and
+// report the measurement back. A worker is only killed (and respawned) when a sample
+// runs over its budget or the worker crashes.
+class worker_pool{
+private:
+    function<dd_t(sample_request_t)> task;
+    vector<worker_t> workers;
+    int next;
+    supervisor watcher;
+    struct sigaction previous_sigpipe;
+    void spawn(int i);
+    void retire(int i);
+    static void worker_loop(function<dd_t(sample_request_t)> task, int request_fd, int response_fd);
+
+public:
+    worker_pool(function<dd_t(sample_request_t)> task, int size);
+    ~worker_pool();
+    int run(sample_request_t request, long long budget, dd_t& result);
+    int size();
+};
+
+#endif